@@ -0,0 +1,238 @@
+/**
+ * addrmap.c
+ *
+ * @autors Stefan Tombers, Alexander Bunte, Jonas Bürse
+ *
+ * Implementation of a map from network addresses to fixed size items.
+ *
+ * The map is a two-level table: the high bits of an address select a block,
+ * the low bits the item within the block. Blocks are allocated when the
+ * first address of their range is added, so sparse address spaces stay
+ * small. Lookup, insertion and removal take O(1). Items are stored by
+ * value and do not move until they are removed.
+ */
+
+#include <string.h>
+#include <assert.h>
+#include "datatypes.h"
+#include "addrmap.h"
+
+/**
+ * Number of addresses per block.
+ */
+#define ADDRMAP_BLOCK_BITS 8
+#define ADDRMAP_BLOCK_SIZE (1 << ADDRMAP_BLOCK_BITS)
+
+/**
+ * Number of blocks covering the whole address space.
+ */
+#define ADDRMAP_NUM_BLOCKS ((1 << ADDRESS_BITS) / ADDRMAP_BLOCK_SIZE)
+
+
+/**
+ * Type with the strictest alignment of the items, which are structures
+ * with integer, floating point and pointer members.
+ */
+typedef union
+{
+	long long   l;
+	long double d;
+	void        *p;
+} ADDRMAP_ALIGN;
+
+
+/**
+ * Data structure for a block of items.
+ */
+typedef struct ADDRMAP_BLOCK
+{
+	int nitems;                                // Number of present items.
+	uint8_t present[ADDRMAP_BLOCK_SIZE / 8];   // Bitmap of the present items.
+	ADDRMAP_ALIGN items[];                     // ADDRMAP_BLOCK_SIZE items, aligned for any of them.
+} ADDRMAP_BLOCK;
+
+
+/**
+ * Data structure for the map.
+ */
+typedef struct _ADDRMAP
+{
+	size_t itemSize;                            // Size of one item.
+	int nitems;                                 // Number of items in the map.
+	ADDRMAP_BLOCK *blocks[ADDRMAP_NUM_BLOCKS];  // Blocks, NULL if empty.
+} _ADDRMAP;
+
+
+/**
+ * Creates a new map for items of size 'itemSize'.
+ *
+ * @param itemSize Size of one item.
+ * @return Handle for the created map.
+ */
+ADDRMAP addrmap_new(size_t itemSize)
+{
+	_ADDRMAP *map = calloc(1, sizeof(*map));
+	map->itemSize = itemSize;
+	return (ADDRMAP)map;
+}
+
+
+/**
+ * Frees all resources allocated for given map.
+ * The handle is invalid afterwards.
+ *
+ * @param m Handle of map to destroy.
+ */
+void addrmap_free(ADDRMAP m)
+{
+	_ADDRMAP *map = (_ADDRMAP *)m;
+	for (int i = 0; i < ADDRMAP_NUM_BLOCKS; i++) {
+		free(map->blocks[i]);
+	}
+	free(map);
+}
+
+
+/**
+ * Adds an item for an address. An existing item is replaced.
+ * If 'data' is NULL the item is zeroed.
+ *
+ * @param m Handle of the map.
+ * @param addr Address of the item.
+ * @param data Item to copy into the map.
+ * @return Pointer to the stored item.
+ */
+void *addrmap_add(ADDRMAP m, CnetAddr addr, void *data)
+{
+	_ADDRMAP *map = (_ADDRMAP *)m;
+	assert(addr < (CnetAddr) (1 << ADDRESS_BITS));
+
+	ADDRMAP_BLOCK **block = &map->blocks[addr >> ADDRMAP_BLOCK_BITS];
+	if (NULL == *block) {
+		*block = calloc(1, sizeof(**block) + ADDRMAP_BLOCK_SIZE * map->itemSize);
+	}
+
+	int i = addr & (ADDRMAP_BLOCK_SIZE - 1);
+	if (!((*block)->present[i / 8] & (1 << (i % 8)))) {
+		(*block)->present[i / 8] |= 1 << (i % 8);
+		(*block)->nitems++;
+		map->nitems++;
+	}
+
+	char *item = (char *) (*block)->items + i * map->itemSize;
+	if (NULL != data) {
+		memcpy(item, data, map->itemSize);
+	} else {
+		memset(item, 0, map->itemSize);
+	}
+	return item;
+}
+
+
+/**
+ * Returns the item of an address or NULL if there is none.
+ *
+ * @param m Handle of the map.
+ * @param addr Address of the item.
+ * @return Pointer to the stored item.
+ */
+void *addrmap_find(ADDRMAP m, CnetAddr addr)
+{
+	_ADDRMAP *map = (_ADDRMAP *)m;
+	if (addr >= (CnetAddr) (1 << ADDRESS_BITS)) {
+		return NULL;
+	}
+
+	ADDRMAP_BLOCK *block = map->blocks[addr >> ADDRMAP_BLOCK_BITS];
+	int i = addr & (ADDRMAP_BLOCK_SIZE - 1);
+	if (NULL == block || !(block->present[i / 8] & (1 << (i % 8)))) {
+		return NULL;
+	}
+	return (char *) block->items + i * map->itemSize;
+}
+
+
+/**
+ * Removes the item of an address, if there is one.
+ * Empty blocks are freed.
+ *
+ * @param m Handle of the map.
+ * @param addr Address of the item.
+ */
+void addrmap_remove(ADDRMAP m, CnetAddr addr)
+{
+	_ADDRMAP *map = (_ADDRMAP *)m;
+	if (NULL == addrmap_find(m, addr)) {
+		return;
+	}
+
+	ADDRMAP_BLOCK **block = &map->blocks[addr >> ADDRMAP_BLOCK_BITS];
+	int i = addr & (ADDRMAP_BLOCK_SIZE - 1);
+	(*block)->present[i / 8] &= ~(1 << (i % 8));
+	map->nitems--;
+	if (--(*block)->nitems == 0) {
+		free(*block);
+		*block = NULL;
+	}
+}
+
+
+/**
+ * Returns the number of items in the map.
+ *
+ * @param m Handle of the map.
+ * @return Number of items.
+ */
+int addrmap_nitems(ADDRMAP m)
+{
+	return ((_ADDRMAP *)m)->nitems;
+}
+
+
+/**
+ * Returns the item of the first address from '*addr' on which has one
+ * and stores this address in '*addr'. Returns NULL if there is none.
+ * All items are visited by calling it with 0 and then with the address
+ * behind the one found.
+ *
+ * @param m Handle of the map.
+ * @param addr First address to look at, the address of the item on return.
+ * @return Pointer to the stored item.
+ */
+void *addrmap_next(ADDRMAP m, CnetAddr *addr)
+{
+	_ADDRMAP *map = (_ADDRMAP *)m;
+
+	for (CnetAddr a = *addr; a < (CnetAddr) (1 << ADDRESS_BITS); a++) {
+		ADDRMAP_BLOCK *block = map->blocks[a >> ADDRMAP_BLOCK_BITS];
+		int i = a & (ADDRMAP_BLOCK_SIZE - 1);
+
+		if (NULL == block) {
+			a |= ADDRMAP_BLOCK_SIZE - 1; // skip the block
+		} else if (block->present[i / 8] & (1 << (i % 8))) {
+			*addr = a;
+			return (char *) block->items + i * map->itemSize;
+		}
+	}
+	return NULL;
+}
+
+
+/**
+ * Returns the number of bytes allocated for the map.
+ *
+ * @param m Handle of the map.
+ * @return Allocated bytes.
+ */
+size_t addrmap_memory(ADDRMAP m)
+{
+	_ADDRMAP *map = (_ADDRMAP *)m;
+	size_t bytes = sizeof(*map);
+
+	for (int i = 0; i < ADDRMAP_NUM_BLOCKS; i++) {
+		if (NULL != map->blocks[i]) {
+			bytes += sizeof(ADDRMAP_BLOCK) + ADDRMAP_BLOCK_SIZE * map->itemSize;
+		}
+	}
+	return bytes;
+}
@@ -0,0 +1,33 @@
+/**
+ * addrmap.h
+ *  
+ * @autors Stefan Tombers, Alexander Bunte, Jonas Bürse
+ *
+ * Header file for a map from network addresses to fixed size items.
+ */
+
+#ifndef ADDRMAP_H_
+#define ADDRMAP_H_
+
+#include <stdlib.h>
+#include <cnet.h>
+
+typedef void * ADDRMAP;
+
+ADDRMAP addrmap_new(size_t itemSize);
+
+void addrmap_free(ADDRMAP m);
+
+void *addrmap_add(ADDRMAP m, CnetAddr addr, void *data);
+
+void *addrmap_find(ADDRMAP m, CnetAddr addr);
+
+void addrmap_remove(ADDRMAP m, CnetAddr addr);
+
+int addrmap_nitems(ADDRMAP m);
+
+void *addrmap_next(ADDRMAP m, CnetAddr *addr);
+
+size_t addrmap_memory(ADDRMAP m);
+
+#endif
@@ -0,0 +1,68 @@
+#!/bin/bash
+
+#
+# benchmark.sh
+#
+# @autors Stefan Tombers, Alexander Bunte, Jonas Bürse
+#
+# Short script to evaluate the routing algorithm on several topology files.
+# For each topology it reports when the forwarding tables stopped changing
+# (convergence time) and how much routing traffic was sent until then.
+# Requires ROUTING_STATS to be enabled in network.c. To compare routing
+# algorithms, run it once for each setting of USE_SPLIT_HORIZON,
+# USE_HOLD_DOWN or USE_LINK_STATE in network.c. The control overhead of
+# the distance vector encodings is compared by switching
+# USE_COMPACT_ROUTING; routing[bytes] counts whole routing datagrams.
+#
+# With MULTICAST_BENCHMARK enabled in milestone3.c it additionally reports
+# the bytes of all multicast datagrams sent over links. Compare runs with
+# MULTICAST_FANOUT in network.c switched on and off.
+#
+# If the route compiler has been built in routes/build, a route file is
+# compiled for each topology, so USE_ROUTE_FILE in network.c gives warm
+# starts. Set USE_ROUTE_FILE to false to compare with cold starts.
+#
+# With OPTIMIZE_WEIGHTS=1 in the environment and the weight optimizer
+# built, link weights are optimized for each topology first (weights.txt,
+# see USE_WEIGHT_FILE in network.c). Otherwise weights.txt is removed, so
+# the bandwidth based weights are used.
+#
+
+#$1 = period of execution
+#$2... = topology files
+
+if [ $# -lt 2 ]; then
+	echo "usage: $0 <period> <topology>..."
+	exit 1
+fi
+
+period=$1
+shift
+
+if [ ! -e tmp/benchmark ]; then
+	mkdir -p tmp/benchmark
+fi
+
+printf "%-16s %16s %10s %12s %16s %18s\n" topology convergence[us] updates datagrams routing[bytes] multicast[bytes]
+
+for topology in "$@"; do
+	rm -f *.o tmp/benchmark/out-*
+	rm -f weights.txt
+	if [ -n "$OPTIMIZE_WEIGHTS" ] && [ -x routes/build/weightoptimizer ]; then
+		routes/build/weightoptimizer $topology weights.txt
+	fi
+	if [ -x routes/build/routecompiler ]; then
+		if [ -e weights.txt ]; then
+			routes/build/routecompiler $topology routes.bin weights.txt > /dev/null
+		else
+			routes/build/routecompiler $topology routes.bin > /dev/null
+		fi
+	fi
+	cnet -W -s -T -e $period $topology -o tmp/benchmark/out-%n > /dev/null
+
+	cat tmp/benchmark/out-* | awk -v topology=$(basename $topology .txt) '
+		/\[forwarding_update\]/ { t = $1 + 0; if (t > last) last = t; updates++ }
+		/\[routing_datagram\]/  { datagrams++; bytes += $NF }
+		/\[multicast_datagram\]/ { multicast += $NF }
+		END { printf "%-16s %16d %10d %12d %16d %18d\n", topology, last, updates, datagrams, bytes, multicast }'
+done
@@ -0,0 +1,219 @@
+/**
+ * boundary.c
+ *
+ * @autors Stefan Tombers, Alexander Bunte, Jonas Bürse
+ *
+ * Implementation of an index of message boundaries.
+ *
+ * It stores the cyclic end offsets of received messages in the order they
+ * are delivered in. All stored offsets lie within 'window' bytes behind the
+ * last popped offset (initially 0), so they are ordered by their distance
+ * to it, which also handles the wraparound at 'maxOffset'.
+ *
+ * The offsets are kept sorted in a preallocated ring. Message ends mostly
+ * arrive in order, so an offset is inserted at the tail or moved back by
+ * a few places, and the next boundary is always at the head. The ring
+ * only grows (doubles) if more messages end within the window than it
+ * has space for; there is no allocation per message.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include "boundary.h"
+
+/**
+ * Initial number of offsets the ring has space for.
+ */
+#define INITIAL_CAPACITY 64
+
+/**
+ * Data structure for the boundary index.
+ */
+typedef struct _BOUNDARY
+{
+	int window;    // Maximal distance of a stored offset to 'base'.
+	int maxOffset; // Offsets are taken modulo maxOffset.
+	int base;      // Last popped offset, all stored offsets lie behind it.
+	int *ring;     // Stored offsets, sorted by distance to 'base'.
+	int capacity;  // Number of offsets the ring has space for (power of 2).
+	int head;      // Position of the first offset in the ring.
+	int numItems;  // Number of stored offsets.
+} _BOUNDARY;
+
+
+/**
+ * Creates a new boundary index.
+ *
+ * @param window Maximal distance of a stored offset to the last popped one.
+ * @param maxOffset Offsets are taken modulo maxOffset.
+ * @return Handle of the boundary index.
+ */
+BOUNDARY boundary_new(int window, int maxOffset)
+{
+	_BOUNDARY *bound = malloc(sizeof(*bound));
+
+	bound->window    = window;
+	bound->maxOffset = maxOffset;
+	bound->base      = 0;
+	bound->ring      = malloc(INITIAL_CAPACITY * sizeof(*bound->ring));
+	bound->capacity  = INITIAL_CAPACITY;
+	bound->head      = 0;
+	bound->numItems  = 0;
+
+	return (BOUNDARY) bound;
+}
+
+
+/**
+ * Frees all resources allocated for the given boundary index.
+ *
+ * @param b Handle of boundary index to destroy.
+ */
+void boundary_free(BOUNDARY b)
+{
+	_BOUNDARY *bound = (_BOUNDARY *)b;
+
+	free(bound->ring);
+	free(bound);
+}
+
+
+/**
+ * Doubles the capacity of the ring.
+ *
+ * @param bound The boundary index.
+ */
+void boundary_grow(_BOUNDARY *bound)
+{
+	int *ring = malloc(2 * bound->capacity * sizeof(*ring));
+
+	for (int i = 0; i < bound->numItems; i++) {
+		ring[i] = bound->ring[(bound->head + i) & (bound->capacity - 1)];
+	}
+	free(bound->ring);
+	bound->ring = ring;
+	bound->capacity *= 2;
+	bound->head = 0;
+}
+
+
+/**
+ * Returns the distance of an offset to the last popped one.
+ *
+ * @param bound The boundary index.
+ * @param offset The offset.
+ * @return Distance in byte.
+ */
+int boundary_distance(_BOUNDARY *bound, int offset)
+{
+	int distance = offset - bound->base;
+	return distance < 0 ? distance + bound->maxOffset : distance;
+}
+
+
+/**
+ * Stores an offset. Storing an offset twice has no effect.
+ *
+ * @param b Handle of the boundary index.
+ * @param offset Offset to store, at most 'window' behind the last popped one.
+ */
+void boundary_insert(BOUNDARY b, int offset)
+{
+	_BOUNDARY *bound = (_BOUNDARY *)b;
+	int distance = boundary_distance(bound, offset);
+
+	assert(distance > 0 && distance <= bound->window);
+
+	/* find the place from the tail */
+	int i = bound->numItems;
+	while (i > 0) {
+		int prevDistance = boundary_distance(bound, bound->ring[(bound->head + i - 1) & (bound->capacity - 1)]);
+		if (prevDistance == distance) {
+			return;
+		}
+		if (prevDistance < distance) {
+			break;
+		}
+		i--;
+	}
+
+	if (bound->numItems == bound->capacity) {
+		boundary_grow(bound);
+	}
+
+	/* shift the larger offsets back */
+	int mask = bound->capacity - 1;
+	for (int j = bound->numItems; j > i; j--) {
+		bound->ring[(bound->head + j) & mask] = bound->ring[(bound->head + j - 1) & mask];
+	}
+	bound->ring[(bound->head + i) & mask] = offset;
+	bound->numItems++;
+}
+
+
+/**
+ * Returns (but keeps) the next offset behind the last popped one.
+ * Returns -1 if the index is empty.
+ *
+ * @param b Handle of the boundary index.
+ * @return Next offset or -1 if the index is empty.
+ */
+int boundary_peek(BOUNDARY b)
+{
+	_BOUNDARY *bound = (_BOUNDARY *)b;
+
+	if (bound->numItems == 0) {
+		return -1;
+	}
+	return bound->ring[bound->head];
+}
+
+
+/**
+ * Removes and returns the next offset behind the last popped one.
+ * Returns -1 if the index is empty.
+ *
+ * @param b Handle of the boundary index.
+ * @return Next offset or -1 if the index is empty.
+ */
+int boundary_pop(BOUNDARY b)
+{
+	_BOUNDARY *bound = (_BOUNDARY *)b;
+
+	if (bound->numItems == 0) {
+		return -1;
+	}
+
+	int offset = bound->ring[bound->head];
+	bound->head = (bound->head + 1) & (bound->capacity - 1);
+	bound->numItems--;
+	bound->base = offset;
+
+	return offset;
+}
+
+
+/**
+ * Returns the number of stored offsets.
+ *
+ * @param b Handle of the boundary index.
+ * @return Number of stored offsets.
+ */
+int boundary_nitems(BOUNDARY b)
+{
+	_BOUNDARY *bound = (_BOUNDARY *)b;
+	return bound->numItems;
+}
+
+
+/**
+ * Returns the number of bytes allocated for the boundary index.
+ *
+ * @param b Handle of the boundary index.
+ * @return Allocated bytes.
+ */
+size_t boundary_memory(BOUNDARY b)
+{
+	_BOUNDARY *bound = (_BOUNDARY *)b;
+	return sizeof(*bound) + bound->capacity * sizeof(*bound->ring);
+}
@@ -0,0 +1,28 @@
+/**
+ * boundary.h
+ *  
+ * @autors Stefan Tombers, Alexander Bunte, Jonas Bürse
+ *
+ * Header file for an index of message boundaries.
+ */
+
+#ifndef BOUNDARY_H_
+#define BOUNDARY_H_
+
+typedef void * BOUNDARY;
+
+BOUNDARY boundary_new(int window, int maxOffset);
+
+void boundary_free(BOUNDARY b);
+
+void boundary_insert(BOUNDARY b, int offset);
+
+int boundary_peek(BOUNDARY b);
+
+int boundary_pop(BOUNDARY b);
+
+int boundary_nitems(BOUNDARY b);
+
+size_t boundary_memory(BOUNDARY b);
+
+#endif
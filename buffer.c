@@ -6,11 +6,29 @@
  * Implementation of a  cyclic buffer.
  *
  * Data are stored in a cyclic buffer using a char array for the data and a
- * bitmap which stores which of the data are currently valid. Data can be
- * stored given a starting position, the data and the length of the data and
- * also be loaded from the buffer.
+ * sorted set of ranges which stores which of the data are currently valid.
+ * Data can be stored given a starting position, the data and the length of
+ * the data and also be loaded from the buffer.
  *
+ * Ranges never wrap around the end of the buffer, a wrapping range is split
+ * in two. Adjacent and overlapping ranges are merged, so storing duplicated
+ * data is harmless. The result of buffer_next_invalid() is cached until the
+ * buffer changes, since the transport layer asks for it several times per
+ * segment.
  *
+ * Ranges are found by binary search, but inserting or removing one moves
+ * the ranges behind it, so these updates are linear in the number of
+ * ranges. This number stays small: the transport layer only stores data
+ * in its receive window, where each range but the last ends at a hole of
+ * lost or reordered segments, so there are at most as many ranges as
+ * segments in the sender's window (MAX_WINDOW_SIZE), usually a few.
+ * Data which only extend one range, like segments arriving in order,
+ * move nothing.
+ *
+ * Space for the data is allocated lazily: the data array holds the bytes
+ * at their position modulo its size and is doubled (up to the length of
+ * the buffer) when the valid bytes and new data do not fit into it.
+ * An empty buffer can give its data array back with buffer_compact().
  */
 
 #include <stdlib.h>
@@ -20,19 +38,42 @@
 #include "buffer.h"
 
 
+/**
+ * Initial number of ranges space is allocated for.
+ */
+#define INITIAL_RANGES 8
+
+/**
+ * Initial size of the data array in byte.
+ */
+#define INITIAL_SIZE 1024
+
+/**
+ * A range of valid bytes [start, end).
+ */
+typedef struct
+{
+	size_t start;
+	size_t end;
+} RANGE;
+
 /**
  * Data structure for the buffer.
  */
 typedef struct _BUFFER
 {
-	size_t  len;     // Length of the buffer.
-	char    *data;   // Stored data of the buffer.
-	uint8_t *bitmap; // Stores which data are valid.
+	size_t  len;        // Length of the buffer.
+	char    *data;      // Stored data of the buffer, byte 'pos' at pos % size.
+	size_t  size;       // Size of data, divides len, 0 if nothing is allocated.
+	RANGE   *ranges;    // Valid ranges, sorted by start.
+	size_t  numRanges;  // Number of valid ranges.
+	size_t  capacity;   // Number of ranges space is allocated for.
+	size_t  cachedPos;  // Position of the last buffer_next_invalid() query.
+	size_t  cachedNext; // Its result.
+	bool    cacheValid; // Whether the cached result is up to date.
 } _BUFFER;
 
-void buffer_validate(BUFFER b, size_t pos);
 void buffer_validate_range(BUFFER b, size_t pos, size_t len);
-void buffer_invalidate(BUFFER b, size_t pos);
 void buffer_invalidate_range(BUFFER b, size_t pos, size_t len);
 
 /**
@@ -45,9 +86,13 @@ BUFFER buffer_new(size_t len)
 {
   _BUFFER *buf = malloc(sizeof(*buf));
 
-	buf->len    = len;
-	buf->data   = malloc(len);
-	buf->bitmap = calloc(len / 8 + 1, sizeof(*buf->bitmap));
+	buf->len        = len;
+	buf->data       = NULL;
+	buf->size       = 0;
+	buf->ranges     = malloc(INITIAL_RANGES * sizeof(*buf->ranges));
+	buf->numRanges  = 0;
+	buf->capacity   = INITIAL_RANGES;
+	buf->cacheValid = false;
 
   return (BUFFER) buf;
 }
@@ -63,10 +108,95 @@ void buffer_free(BUFFER b)
   _BUFFER *buf = (_BUFFER *)b;
 
   free(buf->data);
-	free(buf->bitmap);
+	free(buf->ranges);
   free(buf);
 }
 
+/**
+ * Returns the length of the shortest section of the buffer (which may wrap
+ * around its end) that contains all valid bytes and the 'size' bytes from
+ * position 'pos' on: the length of the buffer minus its largest gap.
+ *
+ * @param buf The buffer.
+ * @param pos Position of the new bytes, less than len.
+ * @param size Number of new bytes.
+ * @return Length of the section.
+ */
+size_t buffer_span(_BUFFER *buf, size_t pos, size_t size)
+{
+	/* the new bytes, sorted by start like the ranges */
+	RANGE add[2] = {{pos, pos + size}, {0, 0}};
+	int numAdd = 1;
+	if (pos + size > buf->len) {
+		add[0].start = 0;
+		add[0].end   = pos + size - buf->len;
+		add[1].start = pos;
+		add[1].end   = buf->len;
+		numAdd = 2;
+	}
+
+	size_t first = -1, end = 0, gap = 0;
+	size_t i = 0;
+	int j = 0;
+	while (i < buf->numRanges || j < numAdd) {
+		RANGE *r;
+		if (j == numAdd || (i < buf->numRanges && buf->ranges[i].start < add[j].start)) {
+			r = &buf->ranges[i++];
+		} else {
+			r = &add[j++];
+		}
+		if (r->start == r->end) {
+			continue;
+		}
+
+		if (first == (size_t) -1) {
+			first = r->start;
+		} else if (r->start > end && r->start - end > gap) {
+			gap = r->start - end;
+		}
+		if (r->end > end) {
+			end = r->end;
+		}
+	}
+	if (first == (size_t) -1) {
+		return 0;
+	}
+
+	/* the gap around the end of the buffer */
+	if (first + buf->len - end > gap) {
+		gap = first + buf->len - end;
+	}
+	return buf->len - gap;
+}
+
+/**
+ * Grows the data array until it holds 'span' bytes. The valid bytes are
+ * moved to their new positions.
+ *
+ * @param buf The buffer.
+ * @param span Number of bytes the data array must hold.
+ */
+void buffer_grow(_BUFFER *buf, size_t span)
+{
+	size_t size = buf->size > 0 ? buf->size : INITIAL_SIZE;
+	while (size < span) {
+		size *= 2;
+	}
+	if (size >= buf->len || buf->len % size != 0) {
+		size = buf->len;
+	}
+
+	char *data = malloc(size);
+	for (size_t i = 0; i < buf->numRanges; i++) {
+		for (size_t pos = buf->ranges[i].start; pos < buf->ranges[i].end; pos++) {
+			data[pos % size] = buf->data[pos % buf->size];
+		}
+	}
+	free(buf->data);
+	buf->data = data;
+	buf->size = size;
+}
+
 /**
  * Stores data 'data' in buffer at position pos.
  *
@@ -80,12 +210,22 @@ void buffer_store(BUFFER b, size_t pos, char *data, size_t size)
   _BUFFER *buf = (_BUFFER *)b;
 
   pos %= buf->len;
-  int wrapping = pos + size - buf->len;
+	if (size == 0) {
+		return;
+	}
+
+	size_t span = buffer_span(buf, pos, size);
+	if (span > buf->size) {
+		buffer_grow(buf, span);
+	}
+
+	size_t start = pos % buf->size;
+  int wrapping = start + size - buf->size;
 
   if (wrapping < 0) {
-    memcpy(buf->data + pos, data, size);
+    memcpy(buf->data + start, data, size);
   } else {
-    memcpy(buf->data + pos, data, size - wrapping);
+    memcpy(buf->data + start, data, size - wrapping);
     memcpy(buf->data, data + size - wrapping, wrapping);
   }
 
@@ -105,12 +245,17 @@ void buffer_load(BUFFER b, size_t pos, char *data, size_t size)
   _BUFFER *buf = (_BUFFER *)b;
 
   pos %= buf->len;
-  int wrapping = pos + size - buf->len;
+	if (size == 0) {
+		return;
+	}
+
+	size_t start = pos % buf->size;
+  int wrapping = start + size - buf->size;
 
   if (wrapping < 0) {
-    memcpy(data, buf->data + pos, size);
+    memcpy(data, buf->data + start, size);
   } else {
-    memcpy(data, buf->data + pos, size - wrapping);
+    memcpy(data, buf->data + start, size - wrapping);
     memcpy(data + size - wrapping, buf->data, wrapping);
   }
 
@@ -118,57 +263,122 @@ void buffer_load(BUFFER b, size_t pos, char *data, size_t size)
 }
 
 /**
- * Validates byte at position 'pos' of buffer 'b'.
+ * Returns the index of the first range which ends at or behind 'pos'
+ * (binary search). Returns the number of ranges if there is none.
  *
- * @param b Handle of buffer.
- * @param pos Position of bit to set.
+ * @param buf The buffer.
+ * @param pos Position in buffer.
+ * @return Index of the range.
  */
-void buffer_validate(BUFFER b, size_t pos)
+size_t buffer_find_range(_BUFFER *buf, size_t pos)
 {
-	_BUFFER *buf = (_BUFFER *)b;
+	size_t low = 0, high = buf->numRanges;
+
+	while (low < high) {
+		size_t mid = (low + high) / 2;
+		if (buf->ranges[mid].end < pos) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return low;
+}
 
-	pos %= buf->len;
-	size_t byte  = pos / 8;
-	uint8_t mask = 1 << (pos % 8);
+/**
+ * Validates the bytes [start, end) which do not wrap around.
+ * Overlapping and adjacent ranges are merged.
+ *
+ * @param buf The buffer.
+ * @param start First byte to validate.
+ * @param end Byte behind the last byte to validate.
+ */
+void buffer_add_range(_BUFFER *buf, size_t start, size_t end)
+{
+	size_t first = buffer_find_range(buf, start);
+	size_t last  = first;
 
-	//TODO what about receiving duplicated data
-	assert(!(buf->bitmap[byte] & mask)); //do not overwrite valid data
-	buf->bitmap[byte] |= mask;
+	/* ranges [first, last) touch the new one */
+	while (last < buf->numRanges && buf->ranges[last].start <= end) {
+		if (buf->ranges[last].start < start) {
+			start = buf->ranges[last].start;
+		}
+		if (buf->ranges[last].end > end) {
+			end = buf->ranges[last].end;
+		}
+		last++;
+	}
+
+	if (first == last) {
+		if (buf->numRanges == buf->capacity) {
+			buf->capacity *= 2;
+			buf->ranges = realloc(buf->ranges, buf->capacity * sizeof(*buf->ranges));
+		}
+		memmove(buf->ranges + first + 1, buf->ranges + first, (buf->numRanges - first) * sizeof(*buf->ranges));
+		buf->numRanges++;
+		last++;
+	}
+
+	buf->ranges[first].start = start;
+	buf->ranges[first].end   = end;
+	if (last > first + 1) {
+		memmove(buf->ranges + first + 1, buf->ranges + last, (buf->numRanges - last) * sizeof(*buf->ranges));
+		buf->numRanges -= last - first - 1;
+	}
 }
 
 /**
- * Validates 'len' bytes from position 'pos' of buffer 'b' on.
+ * Invalidates the bytes [start, end) which do not wrap around.
  *
- * @param b Handle of buffer.
- * @param pos Position of first byte to validate.
- * @param len Number of bytes to validate.
+ * @param buf The buffer.
+ * @param start First byte to invalidate.
+ * @param end Byte behind the last byte to invalidate.
  */
-void buffer_validate_range(BUFFER b, size_t pos, size_t len)
+void buffer_remove_range(_BUFFER *buf, size_t start, size_t end)
 {
-	size_t i;
-	size_t end = pos + len;
-
-	for (i = pos; i < end; i++) {
-		buffer_validate(b, i);
+	size_t i = buffer_find_range(buf, start + 1);
+
+	while (i < buf->numRanges && buf->ranges[i].start < end) {
+		RANGE *r = &buf->ranges[i];
+
+		if (r->start < start && r->end > end) {
+			/* split the range */
+			RANGE tail = {end, r->end};
+			r->end = start;
+			buffer_add_range(buf, tail.start, tail.end);
+			return;
+		} else if (r->start < start) {
+			r->end = start;
+			i++;
+		} else if (r->end > end) {
+			r->start = end;
+			i++;
+		} else {
+			memmove(r, r + 1, (buf->numRanges - i - 1) * sizeof(*buf->ranges));
+			buf->numRanges--;
+		}
 	}
 }
 
 /**
- * Clears byte at position 'pos' of buffer 'b'.
+ * Validates 'len' bytes from position 'pos' of buffer 'b' on.
  *
  * @param b Handle of buffer.
- * @param pos Position of byte to invalidate.
+ * @param pos Position of first byte to validate.
+ * @param len Number of bytes to validate.
  */
-void buffer_invalidate(BUFFER b, size_t pos)
+void buffer_validate_range(BUFFER b, size_t pos, size_t len)
 {
 	_BUFFER *buf = (_BUFFER *)b;
 
 	pos %= buf->len;
-	size_t byte  = pos / 8;
-	uint8_t mask = 1 << (pos % 8);
-
-	assert(buf->bitmap[byte] & mask);
-	buf->bitmap[byte] ^= mask;
+	if (pos + len > buf->len) {
+		buffer_add_range(buf, pos, buf->len);
+		buffer_add_range(buf, 0, pos + len - buf->len);
+	} else if (len > 0) {
+		buffer_add_range(buf, pos, pos + len);
+	}
+	buf->cacheValid = false;
 }
 
 /**
@@ -180,12 +390,16 @@ void buffer_invalidate(BUFFER b, size_t pos)
  */
 void buffer_invalidate_range(BUFFER b, size_t pos, size_t len)
 {
-	size_t i;
-	size_t end = pos + len;
+	_BUFFER *buf = (_BUFFER *)b;
 
-	for (i = pos; i < end; i++) {
-		buffer_invalidate(b, i);
+	pos %= buf->len;
+	if (pos + len > buf->len) {
+		buffer_remove_range(buf, pos, buf->len);
+		buffer_remove_range(buf, 0, pos + len - buf->len);
+	} else if (len > 0) {
+		buffer_remove_range(buf, pos, pos + len);
 	}
+	buf->cacheValid = false;
 }
 
 /**
@@ -197,13 +411,7 @@ void buffer_invalidate_range(BUFFER b, size_t pos, size_t len)
  */
 bool buffer_check(BUFFER b, size_t pos)
 {
-	_BUFFER *buf = (_BUFFER *)b;
-
-	pos %= buf->len;
-	size_t byte  = pos / 8;
-	uint8_t mask = 1 << (pos % 8);
-
-	return buf->bitmap[byte] & mask;
+	return buffer_check_range(b, pos, 1);
 }
 
 /**
@@ -216,16 +424,20 @@ bool buffer_check(BUFFER b, size_t pos)
  */
 bool buffer_check_range(BUFFER b, size_t pos, size_t len)
 {
-	size_t i;
-	size_t end = pos + len;
+	_BUFFER *buf = (_BUFFER *)b;
 
-	for (i = pos; i < end; i++) {
-		if (!buffer_check(b, i)) {
-			return false;
-		}
+	pos %= buf->len;
+	size_t i = buffer_find_range(buf, pos + 1);
+	if (i == buf->numRanges || buf->ranges[i].start > pos) {
+		return len == 0;
+	}
+	if (pos + len <= buf->ranges[i].end) {
+		return true;
 	}
 
-	return true;
+	/* the rest must continue at the beginning of the buffer */
+	return buf->ranges[i].end == buf->len && pos + len - buf->len <= buf->len
+	       && buffer_check_range(b, 0, pos + len - buf->len);
 }
 
 /**
@@ -239,14 +451,127 @@ bool buffer_check_range(BUFFER b, size_t pos, size_t len)
 size_t buffer_next_invalid(BUFFER b, size_t pos)
 {
 	_BUFFER *buf = (_BUFFER *)b;
-	size_t i;
-	size_t end = pos + buf->len;
 
-	for (i = pos; i < end; i++) {
-		if (!buffer_check(b, i)) {
-		  return i % buf->len;
+	pos %= buf->len;
+	if (buf->cacheValid && buf->cachedPos == pos) {
+		return buf->cachedNext;
+	}
+
+	size_t next = pos;
+	size_t i = buffer_find_range(buf, pos + 1);
+	if (i < buf->numRanges && buf->ranges[i].start <= pos) {
+		next = buf->ranges[i].end;
+		if (next == buf->len) {
+			/* continue at the beginning of the buffer */
+			next = 0;
+			if (buf->numRanges > 0 && buf->ranges[0].start == 0) {
+				next = buf->ranges[0].end;
+				if (next >= pos) {
+					next = -1; // the whole buffer is valid
+				}
+			}
 		}
 	}
 
-	return -1;
+	buf->cachedPos  = pos;
+	buf->cachedNext = next;
+	buf->cacheValid = true;
+	return next;
+}
+
+
+/**
+ * Finds the valid ranges within 'len' bytes from position 'pos' on, in the
+ * order they follow 'pos'. A range which wraps around the end of the buffer
+ * is reported once. At most 'max' ranges are stored, as the position of
+ * their first byte and the position behind their last byte.
+ *
+ * @param b Handle of buffer.
+ * @param pos Position to search from.
+ * @param len Number of bytes to search.
+ * @param starts Array for the first positions of the ranges.
+ * @param ends Array for the positions behind the ranges.
+ * @param max Size of the arrays.
+ * @return Number of ranges found.
+ */
+size_t buffer_valid_ranges(BUFFER b, size_t pos, size_t len, size_t *starts, size_t *ends, size_t max)
+{
+	_BUFFER *buf = (_BUFFER *)b;
+	size_t n = 0, prevEnd = -1;
+
+	if (buf->numRanges == 0) {
+		return 0;
+	}
+	pos %= buf->len;
+	size_t first = buffer_find_range(buf, pos + 1);
+
+	/* the range containing pos is visited twice if it starts in front of pos */
+	for (size_t k = 0; k <= buf->numRanges; k++) {
+		size_t i = (first + k) % buf->numRanges;
+		RANGE *r = &buf->ranges[i];
+
+		/* distances from pos, ranges in front of pos lie behind the wrap */
+		size_t start, end;
+		if (k == buf->numRanges) {
+			if (r->start >= pos || r->end <= pos) {
+				break;
+			}
+			start = r->start + buf->len - pos;
+			end   = buf->len;
+		} else if (i >= first) {
+			start = r->start > pos ? r->start - pos : 0;
+			end   = r->end - pos;
+		} else {
+			start = r->start + buf->len - pos;
+			end   = r->end + buf->len - pos;
+		}
+		if (start >= len) {
+			break;
+		}
+		end = end < len ? end : len;
+
+		if (n > 0 && start == prevEnd) {
+			ends[n - 1] = (pos + end) % buf->len; // continued behind the wrap
+		} else if (n < max) {
+			starts[n] = (pos + start) % buf->len;
+			ends[n]   = (pos + end) % buf->len;
+			n++;
+		} else {
+			break;
+		}
+		prevEnd = end;
+	}
+	return n;
+}
+
+
+/**
+ * Frees the data array of the buffer if no byte is valid.
+ * It is allocated again when data are stored.
+ *
+ * @param b Handle of buffer.
+ */
+void buffer_compact(BUFFER b)
+{
+	_BUFFER *buf = (_BUFFER *)b;
+
+	if (buf->numRanges == 0) {
+		free(buf->data);
+		buf->data = NULL;
+		buf->size = 0;
+	}
+}
+
+
+/**
+ * Returns the number of bytes allocated for the buffer.
+ *
+ * @param b Handle of buffer.
+ * @return Allocated bytes.
+ */
+size_t buffer_memory(BUFFER b)
+{
+	_BUFFER *buf = (_BUFFER *)b;
+
+	return sizeof(*buf) + buf->size + buf->capacity * sizeof(*buf->ranges);
 }
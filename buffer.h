@@ -25,4 +25,10 @@ bool buffer_check_range(BUFFER b, size_t pos, size_t len);
 
 size_t buffer_next_invalid(BUFFER b, size_t pos);
 
+size_t buffer_valid_ranges(BUFFER b, size_t pos, size_t len, size_t *starts, size_t *ends, size_t max);
+
+void buffer_compact(BUFFER b);
+
+size_t buffer_memory(BUFFER b);
+
 #endif
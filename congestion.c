@@ -0,0 +1,684 @@
+/**
+ * congestion.c
+ *
+ * @autors Stefan Tombers, Alexander Bunte, Jonas Bürse
+ *
+ * Congestion control algorithms of the transport layer.
+ *
+ * A congestion controller holds the congestion window of one connection in
+ * segments and the rate the pacer sends at. The transport layer reports
+ * acknowledgments, duplicated acknowledgments, timeouts and congestion
+ * echoes to it. All connections of a node use the same algorithm, which is
+ * selected at boot:
+ *
+ * reno     slow start, congestion avoidance and fast recovery (RFC 5681)
+ * newreno  Reno which resends the next hole on partial ACKs (RFC 6582)
+ * cubic    the window grows with a cubic function of the time since the
+ *          last reduction, fast recovery as NewReno (RFC 8312)
+ * bbr      model based: paces at the estimated bottleneck bandwidth and
+ *          keeps two bandwidth-delay products in flight, losses do not
+ *          reduce the window
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <cnet.h>
+#include "congestion.h"
+
+
+/**
+ * Number of duplicated ACKs which indicate a lost segment.
+ */
+#define DUPACK_THRESHOLD 3
+
+/**
+ * Factors by which the pacing rate of the window based algorithms exceeds
+ * window / RTT, during slow start and afterwards, so the window can grow.
+ */
+#define PACING_GAIN_SLOW_START 2.0
+#define PACING_GAIN 1.25
+
+/**
+ * CUBIC: scaling constant (segments / sec^3) and window reduction factor.
+ */
+#define CUBIC_C 0.4
+#define CUBIC_BETA 0.7
+
+/**
+ * BBR: pacing gain of the startup phase, the window in bandwidth-delay
+ * products, the smallest window in segments, the number of round trips
+ * the bandwidth filter spans and the time in usec the minimal RTT is kept.
+ */
+#define BBR_STARTUP_GAIN 2.89
+#define BBR_CWND_GAIN 2.0
+#define BBR_MIN_CWND 4
+#define BBR_BW_ROUNDS 10
+#define BBR_MIN_RTT_WINDOW 10000000
+
+/**
+ * BBR phases.
+ */
+#define BBR_STARTUP 0
+#define BBR_DRAIN 1
+#define BBR_PROBE_BW 2
+
+/**
+ * BBR: pacing gains of the bandwidth probing cycle, one per round trip.
+ */
+static const double bbrCycle[] = {1.25, 0.75, 1, 1, 1, 1, 1, 1};
+#define BBR_CYCLE_LENGTH (sizeof(bbrCycle) / sizeof(bbrCycle[0]))
+
+
+typedef struct _CONGESTION _CONGESTION;
+
+/**
+ * Operations of a congestion control algorithm. The acknowledgment
+ * handlers return whether the first unacknowledged segment has to be
+ * retransmitted at once.
+ */
+typedef struct
+{
+	const char *name;
+	bool (*on_ack)(_CONGESTION *cc, size_t bytes, size_t inFlight, CnetTime rtt, CnetTime srtt);
+	bool (*on_dupack)(_CONGESTION *cc, int dupacks, size_t inFlight);
+	void (*on_timeout)(_CONGESTION *cc);
+	void (*on_ecn)(_CONGESTION *cc);
+	double (*pacing_rate)(_CONGESTION *cc, CnetTime srtt);
+	void (*route_changed)(_CONGESTION *cc);
+} ALGORITHM;
+
+/**
+ * Data structure for the congestion controller of a connection.
+ */
+struct _CONGESTION
+{
+	const ALGORITHM *algorithm;
+	double   cwnd;          // Congestion window in segments.
+	double   ssthresh;      // Slow start threshold in segments.
+	size_t   limit;         // Largest window the connection uses.
+	size_t   segmentSize;   // Payload size of the segments in byte.
+	uint64_t delivered;     // Bytes acknowledged so far.
+
+	/* fast recovery (NewReno, CUBIC) */
+	bool     inRecovery;    // Lost segments are being recovered.
+	uint64_t recover;       // Recovery ends when 'delivered' reaches it.
+
+	/* CUBIC */
+	double   wMax;          // Window before the last reduction.
+	double   wEst;          // Window Reno would have.
+	double   k;             // Seconds the cubic function needs to reach wMax.
+	CnetTime epochStart;    // Start of the current growth epoch, 0 if none.
+
+	/* BBR */
+	int      state;         // Phase, BBR_STARTUP, BBR_DRAIN or BBR_PROBE_BW.
+	double   btlBw;         // Estimated bottleneck bandwidth in byte / usec.
+	double   bwSamples[BBR_BW_ROUNDS]; // Delivery rates of the last rounds.
+	int      rounds;        // Completed round trips.
+	uint64_t roundDelivered;// 'delivered' at the start of the round.
+	CnetTime roundStart;    // Start of the round, 0 before the first ACK.
+	CnetTime minRtt;        // Minimal RTT seen, 0 if none.
+	CnetTime minRttStamp;   // Time minRtt was measured.
+	double   fullBw;        // Bandwidth startup last grew to.
+	int      fullBwRounds;  // Rounds without growth by a quarter.
+	int      cycleIndex;    // Position in bbrCycle.
+};
+
+
+/**********************************************************/
+/*					Reno and NewReno						*/
+/**********************************************************/
+
+/**
+ * Grows the window for 'acked' acknowledged segments:
+ * by one segment per segment in slow start, by one segment
+ * per window in congestion avoidance.
+ */
+void reno_increase(_CONGESTION *cc, double acked)
+{
+	if (cc->cwnd < cc->ssthresh) {
+		cc->cwnd += acked;
+	} else {
+		cc->cwnd += acked / cc->cwnd;
+	}
+}
+
+bool reno_on_ack(_CONGESTION *cc, size_t bytes, size_t inFlight, CnetTime rtt, CnetTime srtt)
+{
+	if (cc->inRecovery) {
+		/* deflate the window */
+		cc->inRecovery = false;
+		cc->cwnd = cc->ssthresh;
+	} else {
+		reno_increase(cc, (double) bytes / cc->segmentSize);
+	}
+	return false;
+}
+
+bool newreno_on_ack(_CONGESTION *cc, size_t bytes, size_t inFlight, CnetTime rtt, CnetTime srtt)
+{
+	if (cc->inRecovery && cc->delivered < cc->recover) {
+		/* partial acknowledgment: the next segment is lost as well */
+		cc->cwnd = fmax(cc->cwnd - (double) bytes / cc->segmentSize + 1, 1);
+		return true;
+	}
+	return reno_on_ack(cc, bytes, inFlight, rtt, srtt);
+}
+
+bool reno_on_dupack(_CONGESTION *cc, int dupacks, size_t inFlight)
+{
+	if (cc->inRecovery) {
+		/* inflate the window, a segment left the network */
+		cc->cwnd += 1;
+		return false;
+	}
+	if (dupacks != DUPACK_THRESHOLD) {
+		return false;
+	}
+
+	cc->ssthresh   = fmax((double) inFlight / cc->segmentSize / 2, 2);
+	cc->cwnd       = cc->ssthresh + DUPACK_THRESHOLD;
+	cc->inRecovery = true;
+	cc->recover    = cc->delivered + inFlight;
+	return true;
+}
+
+void reno_on_timeout(_CONGESTION *cc)
+{
+	cc->ssthresh   = fmax(cc->cwnd / 2, 2);
+	cc->cwnd       = 1;
+	cc->inRecovery = false;
+}
+
+void reno_on_ecn(_CONGESTION *cc)
+{
+	cc->ssthresh = fmax(cc->cwnd / 2, 1);
+	cc->cwnd     = cc->ssthresh;
+}
+
+/**
+ * Sends a window per RTT, faster in slow start. Returns 0 without RTT.
+ */
+double reno_pacing_rate(_CONGESTION *cc, CnetTime srtt)
+{
+	double gain = cc->cwnd < cc->ssthresh ? PACING_GAIN_SLOW_START : PACING_GAIN;
+
+	if (srtt <= 0) {
+		return 0;
+	}
+	return gain * fmin(cc->cwnd, cc->limit) * cc->segmentSize / srtt;
+}
+
+/**
+ * Slow start may grow the window up to the limit of the new route.
+ */
+void reno_route_changed(_CONGESTION *cc)
+{
+	cc->ssthresh = cc->limit;
+}
+
+
+/**********************************************************/
+/*					CUBIC									*/
+/**********************************************************/
+
+/**
+ * Reduces the window after a loss or a congestion echo and ends the
+ * growth epoch. With fast convergence wMax is lowered further if the
+ * window did not reach it again, which leaves bandwidth to new flows.
+ */
+void cubic_reduce(_CONGESTION *cc)
+{
+	if (cc->cwnd < cc->wMax) {
+		cc->wMax = cc->cwnd * (1 + CUBIC_BETA) / 2;
+	} else {
+		cc->wMax = cc->cwnd;
+	}
+	cc->ssthresh   = fmax(cc->cwnd * CUBIC_BETA, 2);
+	cc->epochStart = 0;
+}
+
+bool cubic_on_ack(_CONGESTION *cc, size_t bytes, size_t inFlight, CnetTime rtt, CnetTime srtt)
+{
+	double acked = (double) bytes / cc->segmentSize;
+	CnetTime now = nodeinfo.time_in_usec;
+
+	if (cc->inRecovery) {
+		if (cc->delivered < cc->recover) {
+			return true; // partial acknowledgment as NewReno
+		}
+		cc->inRecovery = false;
+		cc->cwnd = cc->ssthresh;
+		return false;
+	}
+	if (cc->cwnd < cc->ssthresh) {
+		cc->cwnd += acked;
+		return false;
+	}
+
+	if (cc->epochStart == 0) {
+		cc->epochStart = now;
+		cc->k    = cc->cwnd < cc->wMax ? cbrt((cc->wMax - cc->cwnd) / CUBIC_C) : 0;
+		cc->wMax = fmax(cc->wMax, cc->cwnd);
+		cc->wEst = cc->cwnd;
+	}
+
+	/* the window the cubic function reaches one RTT later */
+	double t = (now - cc->epochStart + srtt) / 1000000.0;
+	double target = CUBIC_C * pow(t - cc->k, 3) + cc->wMax;
+
+	if (target > cc->cwnd) {
+		cc->cwnd += (target - cc->cwnd) / cc->cwnd * acked;
+	} else {
+		cc->cwnd += 0.01 * acked / cc->cwnd;
+	}
+
+	/* TCP friendly region: never grow slower than Reno */
+	cc->wEst += 3 * (1 - CUBIC_BETA) / (1 + CUBIC_BETA) * acked / cc->cwnd;
+	cc->cwnd  = fmax(cc->cwnd, cc->wEst);
+	return false;
+}
+
+bool cubic_on_dupack(_CONGESTION *cc, int dupacks, size_t inFlight)
+{
+	if (cc->inRecovery || dupacks != DUPACK_THRESHOLD) {
+		return false;
+	}
+
+	cubic_reduce(cc);
+	cc->cwnd       = cc->ssthresh;
+	cc->inRecovery = true;
+	cc->recover    = cc->delivered + inFlight;
+	return true;
+}
+
+void cubic_on_timeout(_CONGESTION *cc)
+{
+	cubic_reduce(cc);
+	cc->cwnd       = 1;
+	cc->inRecovery = false;
+}
+
+void cubic_on_ecn(_CONGESTION *cc)
+{
+	cubic_reduce(cc);
+	cc->cwnd = cc->ssthresh;
+}
+
+void cubic_route_changed(_CONGESTION *cc)
+{
+	cc->ssthresh   = cc->limit;
+	cc->epochStart = 0;
+}
+
+
+/**********************************************************/
+/*					BBR										*/
+/**********************************************************/
+
+/**
+ * Bandwidth-delay product in byte, 0 while it is unknown.
+ */
+double bbr_bdp(_CONGESTION *cc)
+{
+	return cc->btlBw * cc->minRtt;
+}
+
+/**
+ * Moves to the next phase at the end of a round trip. Startup ends when
+ * the bandwidth did not grow by a quarter for three rounds, drain when
+ * the queue built up in startup is gone.
+ */
+void bbr_next_round(_CONGESTION *cc, size_t inFlight)
+{
+	switch (cc->state) {
+	case BBR_STARTUP:
+		if (cc->btlBw >= 1.25 * cc->fullBw) {
+			cc->fullBw = cc->btlBw;
+			cc->fullBwRounds = 0;
+		} else if (++cc->fullBwRounds >= 3) {
+			cc->state = BBR_DRAIN;
+		}
+		break;
+	case BBR_DRAIN:
+		if (inFlight <= bbr_bdp(cc)) {
+			cc->state = BBR_PROBE_BW;
+			cc->cycleIndex = 0;
+		}
+		break;
+	default:
+		cc->cycleIndex = (cc->cycleIndex + 1) % BBR_CYCLE_LENGTH;
+		break;
+	}
+}
+
+bool bbr_on_ack(_CONGESTION *cc, size_t bytes, size_t inFlight, CnetTime rtt, CnetTime srtt)
+{
+	CnetTime now = nodeinfo.time_in_usec;
+
+	if (rtt > 0 && (cc->minRtt == 0 || rtt <= cc->minRtt || now - cc->minRttStamp > BBR_MIN_RTT_WINDOW)) {
+		cc->minRtt = rtt;
+		cc->minRttStamp = now;
+	}
+
+	/* one delivery rate sample per round trip, the filter keeps the maximum */
+	if (cc->roundStart == 0) {
+		cc->roundStart = now;
+		cc->roundDelivered = cc->delivered - bytes;
+	}
+	if (cc->minRtt > 0 && now - cc->roundStart >= cc->minRtt) {
+		cc->bwSamples[cc->rounds % BBR_BW_ROUNDS] = (cc->delivered - cc->roundDelivered) / (double) (now - cc->roundStart);
+		cc->rounds++;
+		cc->btlBw = 0;
+		for (int i = 0; i < BBR_BW_ROUNDS; i++) {
+			cc->btlBw = fmax(cc->btlBw, cc->bwSamples[i]);
+		}
+		cc->roundStart = now;
+		cc->roundDelivered = cc->delivered;
+		bbr_next_round(cc, inFlight);
+	}
+
+	if (cc->btlBw > 0) {
+		cc->cwnd = fmax(BBR_CWND_GAIN * bbr_bdp(cc) / cc->segmentSize, BBR_MIN_CWND);
+	} else {
+		cc->cwnd += (double) bytes / cc->segmentSize;
+	}
+	return false;
+}
+
+bool bbr_on_dupack(_CONGESTION *cc, int dupacks, size_t inFlight)
+{
+	return dupacks == DUPACK_THRESHOLD;
+}
+
+/**
+ * The window is restored from the model with the next ACK.
+ */
+void bbr_on_timeout(_CONGESTION *cc)
+{
+	cc->cwnd = 1;
+}
+
+void bbr_on_ecn(_CONGESTION *cc)
+{
+}
+
+double bbr_pacing_rate(_CONGESTION *cc, CnetTime srtt)
+{
+	double gain = cc->state == BBR_STARTUP ? BBR_STARTUP_GAIN :
+	              cc->state == BBR_DRAIN   ? 1 / BBR_STARTUP_GAIN : bbrCycle[cc->cycleIndex];
+
+	if (cc->btlBw > 0) {
+		return gain * cc->btlBw;
+	}
+	if (srtt > 0) {
+		return BBR_STARTUP_GAIN * fmin(cc->cwnd, cc->limit) * cc->segmentSize / srtt;
+	}
+	return 0;
+}
+
+/**
+ * The model of the old route is useless, startup begins again.
+ */
+void bbr_route_changed(_CONGESTION *cc)
+{
+	memset(cc->bwSamples, 0, sizeof(cc->bwSamples));
+	cc->btlBw        = 0;
+	cc->minRtt       = 0;
+	cc->roundStart   = 0;
+	cc->state        = BBR_STARTUP;
+	cc->fullBw       = 0;
+	cc->fullBwRounds = 0;
+}
+
+
+/**********************************************************/
+/*					Interface								*/
+/**********************************************************/
+
+static const ALGORITHM algorithms[] = {
+	{"reno",    reno_on_ack,    reno_on_dupack,  reno_on_timeout,  reno_on_ecn,  reno_pacing_rate, reno_route_changed},
+	{"newreno", newreno_on_ack, reno_on_dupack,  reno_on_timeout,  reno_on_ecn,  reno_pacing_rate, reno_route_changed},
+	{"cubic",   cubic_on_ack,   cubic_on_dupack, cubic_on_timeout, cubic_on_ecn, reno_pacing_rate, cubic_route_changed},
+	{"bbr",     bbr_on_ack,     bbr_on_dupack,   bbr_on_timeout,   bbr_on_ecn,   bbr_pacing_rate,  bbr_route_changed},
+};
+#define NUM_ALGORITHMS (sizeof(algorithms) / sizeof(algorithms[0]))
+
+/**
+ * Algorithm of the connections created from now on.
+ */
+const ALGORITHM *algorithm = &algorithms[0];
+
+
+/**
+ * Selects the algorithm of the connections created from now on.
+ * Returns false and keeps the current one if the name is unknown.
+ *
+ * @param name Name of the algorithm, e.g. "newreno".
+ * @return Whether the algorithm exists.
+ */
+bool congestion_select(const char *name)
+{
+	for (size_t i = 0; i < NUM_ALGORITHMS; i++) {
+		if (strcmp(algorithms[i].name, name) == 0) {
+			algorithm = &algorithms[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Selects the algorithm of this node from a file. Each line holds the name
+ * of a node, or * for all nodes, and the name of an algorithm. A line for
+ * the node itself takes precedence. Lines starting with # are comments.
+ * Returns false if the file cannot be read.
+ *
+ * @param name Name of the file.
+ */
+bool congestion_load(const char *name)
+{
+	FILE *file = fopen(name, "r");
+	if (NULL == file) {
+		return false;
+	}
+
+	char line[128], node[64], choice[32];
+	bool own = false;
+	while (fgets(line, sizeof(line), file) != NULL) {
+		if (line[0] == '#' || sscanf(line, "%63s %31s", node, choice) != 2) {
+			continue;
+		}
+		if (strcmp(node, nodeinfo.nodename) == 0) {
+			own = congestion_select(choice) || own;
+		} else if (strcmp(node, "*") == 0 && !own) {
+			congestion_select(choice);
+		}
+	}
+
+	fclose(file);
+	return true;
+}
+
+/**
+ * Returns the name of the selected algorithm.
+ */
+const char *congestion_name()
+{
+	return algorithm->name;
+}
+
+/**
+ * Creates a congestion controller with the selected algorithm.
+ *
+ * @param limit Largest window in segments the connection uses.
+ * @param segmentSize Payload size of the segments in byte.
+ * @return Handle for the controller.
+ */
+CONGESTION congestion_new(size_t limit, size_t segmentSize)
+{
+	_CONGESTION *cc = calloc(1, sizeof(*cc));
+
+	cc->algorithm   = algorithm;
+	cc->cwnd        = 1;
+	cc->ssthresh    = limit; // slow start until the first loss
+	cc->limit       = limit;
+	cc->segmentSize = segmentSize;
+	cc->state       = BBR_STARTUP;
+
+	return (CONGESTION) cc;
+}
+
+/**
+ * Frees all resources allocated for given controller.
+ * The handle is invalid afterwards.
+ *
+ * @param c Handle of the controller.
+ */
+void congestion_free(CONGESTION c)
+{
+	free(c);
+}
+
+
+/**
+ * Returns the number of bytes allocated for the controller.
+ *
+ * @param c Handle of the controller.
+ * @return Allocated bytes.
+ */
+size_t congestion_memory(CONGESTION c)
+{
+	return sizeof(_CONGESTION);
+}
+
+/**
+ * Keeps the window within the limit, a larger window could not be
+ * used and would only take long to shrink after a loss.
+ */
+void congestion_clamp(_CONGESTION *cc)
+{
+	cc->cwnd = fmin(fmax(cc->cwnd, 1), cc->limit);
+}
+
+/**
+ * Updates the largest window and the segment size of the connection.
+ *
+ * @param c Handle of the controller.
+ * @param limit Largest window in segments the connection uses.
+ * @param segmentSize Payload size of the segments in byte.
+ */
+void congestion_set_path(CONGESTION c, size_t limit, size_t segmentSize)
+{
+	_CONGESTION *cc = (_CONGESTION *) c;
+
+	cc->limit       = limit;
+	cc->segmentSize = segmentSize;
+	congestion_clamp(cc);
+}
+
+/**
+ * Adapts the controller to a new route, set with congestion_set_path().
+ *
+ * @param c Handle of the controller.
+ */
+void congestion_route_changed(CONGESTION c)
+{
+	_CONGESTION *cc = (_CONGESTION *) c;
+
+	cc->algorithm->route_changed(cc);
+	congestion_clamp(cc);
+}
+
+/**
+ * Reports an acknowledgment of new data.
+ *
+ * @param c Handle of the controller.
+ * @param bytes Number of newly acknowledged bytes.
+ * @param inFlight Bytes still waiting for acknowledgment.
+ * @param rtt RTT sample taken from this acknowledgment, 0 if none.
+ * @param srtt Smoothed RTT, 0 if it is unknown.
+ * @return Whether the first unacknowledged segment has to be resent.
+ */
+bool congestion_on_ack(CONGESTION c, size_t bytes, size_t inFlight, CnetTime rtt, CnetTime srtt)
+{
+	_CONGESTION *cc = (_CONGESTION *) c;
+
+	cc->delivered += bytes;
+	bool retransmit = cc->algorithm->on_ack(cc, bytes, inFlight, rtt, srtt);
+	congestion_clamp(cc);
+	return retransmit;
+}
+
+/**
+ * Reports a duplicated acknowledgment.
+ *
+ * @param c Handle of the controller.
+ * @param dupacks Number of duplicates of the acknowledgment so far.
+ * @param inFlight Bytes waiting for acknowledgment.
+ * @return Whether the first unacknowledged segment has to be resent.
+ */
+bool congestion_on_dupack(CONGESTION c, int dupacks, size_t inFlight)
+{
+	_CONGESTION *cc = (_CONGESTION *) c;
+
+	bool retransmit = cc->algorithm->on_dupack(cc, dupacks, inFlight);
+	congestion_clamp(cc);
+	return retransmit;
+}
+
+/**
+ * Reports an expired retransmission timer.
+ *
+ * @param c Handle of the controller.
+ */
+void congestion_on_timeout(CONGESTION c)
+{
+	_CONGESTION *cc = (_CONGESTION *) c;
+
+	cc->algorithm->on_timeout(cc);
+	congestion_clamp(cc);
+}
+
+/**
+ * Reports that the receiver echoed congestion, at most once per RTT.
+ *
+ * @param c Handle of the controller.
+ */
+void congestion_on_ecn(CONGESTION c)
+{
+	_CONGESTION *cc = (_CONGESTION *) c;
+
+	cc->algorithm->on_ecn(cc);
+	congestion_clamp(cc);
+}
+
+/**
+ * Returns the rate the connection should be paced at.
+ *
+ * @param c Handle of the controller.
+ * @param srtt Smoothed RTT, 0 if it is unknown.
+ * @return Rate in byte / usec, 0 if it is unknown.
+ */
+double congestion_pacing_rate(CONGESTION c, CnetTime srtt)
+{
+	_CONGESTION *cc = (_CONGESTION *) c;
+
+	return cc->algorithm->pacing_rate(cc, srtt);
+}
+
+/**
+ * Returns the congestion window.
+ *
+ * @param c Handle of the controller.
+ * @return Window in segments, at least 1.
+ */
+size_t congestion_cwnd(CONGESTION c)
+{
+	_CONGESTION *cc = (_CONGESTION *) c;
+
+	return (size_t) cc->cwnd;
+}
@@ -0,0 +1,42 @@
+/**
+ * congestion.h
+ *
+ * @autors Stefan Tombers, Alexander Bunte, Jonas Bürse
+ *
+ * Header file for the congestion control algorithms of the transport layer.
+ */
+
+#ifndef CONGESTION_H_
+#define CONGESTION_H_
+
+typedef void * CONGESTION;
+
+bool congestion_select(const char *name);
+
+bool congestion_load(const char *file);
+
+const char *congestion_name();
+
+CONGESTION congestion_new(size_t limit, size_t segmentSize);
+
+void congestion_free(CONGESTION cc);
+
+size_t congestion_memory(CONGESTION cc);
+
+void congestion_set_path(CONGESTION cc, size_t limit, size_t segmentSize);
+
+void congestion_route_changed(CONGESTION cc);
+
+bool congestion_on_ack(CONGESTION cc, size_t bytes, size_t inFlight, CnetTime rtt, CnetTime srtt);
+
+bool congestion_on_dupack(CONGESTION cc, int dupacks, size_t inFlight);
+
+void congestion_on_timeout(CONGESTION cc);
+
+void congestion_on_ecn(CONGESTION cc);
+
+double congestion_pacing_rate(CONGESTION cc, CnetTime srtt);
+
+size_t congestion_cwnd(CONGESTION cc);
+
+#endif
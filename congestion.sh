@@ -0,0 +1,53 @@
+#!/bin/bash
+
+#
+# congestion.sh
+#
+# @autors Stefan Tombers, Alexander Bunte, Jonas Bürse
+#
+# Short script to compare the congestion control algorithms of the
+# transport layer (see congestion.c). For each topology and algorithm it
+# writes congestion.txt, which selects the algorithm on all nodes, runs
+# cnet and reports the delivered messages, the message bandwidth, the
+# average delivery time and the efficiency from the cnet statistics.
+# congestion.txt is removed afterwards, so CONGESTION_CONTROL in
+# transport.c applies again.
+#
+# Without topology files saarnet-3a.txt and saarnet-8a.txt are used.
+#
+
+#$1 = period of execution
+#$2... = topology files
+
+if [ $# -lt 1 ]; then
+	echo "usage: $0 <period> [topology]..."
+	exit 1
+fi
+
+period=$1
+shift
+
+topologies="$@"
+if [ -z "$topologies" ]; then
+	topologies="saarnet-3a.txt saarnet-8a.txt"
+fi
+
+algorithms="reno newreno cubic bbr"
+
+printf "%-16s %-8s %10s %16s %18s %12s\n" topology cc delivered bandwidth[bps] delivery_time[us] efficiency
+
+for topology in $topologies; do
+	for algorithm in $algorithms; do
+		rm -f *.o
+		echo "* $algorithm" > congestion.txt
+
+		cnet -W -s -T -e $period $topology 2>&1 | awk -F: -v topology=$(basename $topology .txt) -v cc=$algorithm '
+			/Messages delivered/    { delivered = $2 + 0 }
+			/Message bandwidth/     { bandwidth = $2 + 0 }
+			/Average delivery time/ { delay = $2 + 0 }
+			/Efficiency/            { efficiency = $2 }
+			END { gsub(/ /, "", efficiency); printf "%-16s %-8s %10d %16d %18d %12s\n", topology, cc, delivered, bandwidth, delay, efficiency }'
+	done
+done
+
+rm -f congestion.txt
@@ -11,11 +11,52 @@
  */
 #define MAX_NEIGHBOURS 100
 
+/**
+ * Width of network addresses in bits, 8 or 16.
+ * 16 bit addresses allow networks with more than 256 nodes.
+ */
+#define ADDRESS_BITS 16
+
+#if ADDRESS_BITS == 16
+typedef uint16_t NETADDR;
+#else
+typedef uint8_t NETADDR;
+#endif
+
+/**
+ * If true, segments carry the send time and echo the send time of the
+ * segment which advanced the acknowledgment, which gives unambiguous
+ * RTT samples also for retransmitted segments.
+ */
+#define USE_TIMESTAMPS true
+
+/**
+ * If true, acknowledgments report up to MAX_SACK_BLOCKS ranges received
+ * behind the acknowledged offset (selective acknowledgments), as far as
+ * the segment has room for them.
+ */
+#define USE_SACK true
+#define MAX_SACK_BLOCKS 3
+
+/**
+ * If true, small messages are packed into one segment while data are
+ * unacknowledged. A segment reports up to MAX_SEGMENT_BOUNDARIES ends of
+ * messages inside its payload, the end of the segment is marked by isLast.
+ */
+#define USE_COALESCING true
+#define MAX_SEGMENT_BOUNDARIES 7
+
+#define ACK_TIMER EV_TIMER0
 #define LINK_TIMER EV_TIMER1
 #define TRANSPORT_TIMER EV_TIMER2
 #define ROUTING_TIMER EV_TIMER3
-#define GEARING_TIMER EV_TIMER4
+#define PACING_TIMER EV_TIMER4
 #define CYCLIC_OUTPUT_TIMER EV_TIMER5
+#define ROUTING_FLUSH_TIMER EV_TIMER6
+#define HOLD_DOWN_TIMER EV_TIMER7
+#define SPF_TIMER EV_TIMER8
+#define HELLO_TIMER EV_TIMER9
+#define COALESCE_TIMER EV_TIMER10
 
 /**
  * Computes the smaller of two numbers
@@ -35,17 +76,40 @@ typedef struct
 
 /* Data structures for transport layer */
 
+typedef struct
+{
+  uint32_t start;      // first received offset
+  uint32_t end;        // offset behind the received range
+} sack_block;
+
 typedef struct
 {
   uint32_t offset;     // sequence number of segment
   uint32_t ackOffset;  // sequence number last continuously received segment + 1
   bool     isLast;     // last segment of a message
+  bool     ecnEcho;    // congestion was experienced on the way to the receiver
+#if USE_TIMESTAMPS == true
+  uint32_t timestamp;  // send time of the segment
+  uint32_t tsEcho;     // timestamp of the segment which advanced ackOffset
+#endif
+#if USE_SACK == true
+  int        numSacks;                // number of valid sack blocks
+  sack_block sacks[MAX_SACK_BLOCKS];  // ranges received behind ackOffset
+#endif
+#if USE_COALESCING == true
+  int      numBounds;                       // number of message ends inside the payload
+  uint16_t bounds[MAX_SEGMENT_BOUNDARIES];  // message ends relative to offset
+#endif
 } segment_header;
 
 typedef struct
 {
-  uint32_t offset;     // sequence number of segment + isLast
-  uint32_t ackOffset;  // sequence number last continuously received segment + 1
+  uint32_t offset;     // sequence number of segment + isLast + number of message ends
+  uint32_t ackOffset;  // sequence number last continuously received segment + 1 + ecnEcho + number of sack blocks
+#if USE_TIMESTAMPS == true
+  uint32_t timestamp;  // send time of the segment
+  uint32_t tsEcho;     // timestamp of the segment which advanced ackOffset
+#endif
 } marshaled_segment_header;
 
 typedef struct
@@ -57,14 +121,37 @@ typedef struct
 
 /* Data structures for network layer. */
 
+/**
+ * Traffic classes. Each class has its own forwarding table:
+ * bulk traffic follows the bandwidth weight, latency sensitive
+ * traffic the route with minimal delay.
+ */
+#define CLASS_BULK 0
+#define CLASS_LATENCY 1
+#define NUM_TRAFFIC_CLASSES 2
+
 typedef struct
 {
-  uint8_t srcaddr;  // 0 - 255
-  uint8_t destaddr;
+  NETADDR srcaddr;  // 0 - 2^ADDRESS_BITS-1
+  NETADDR destaddr; // destination or group address if multicast
   uint8_t hoplimit; // time to live
+  uint8_t tclass;   // traffic class, selects the forwarding table
   bool    routing;	// 1 = routing protocol, 0 = network protocol
+  bool    multicast; // 1 = payload starts with a multicast_header
+  bool    congested; // 1 = a queue on the route was congested (ECN)
 } datagram_header;
 
+/**
+ * Maximal number of members of a multicast group.
+ */
+#define MAX_GROUP_MEMBERS 64
+
+typedef struct
+{
+  uint8_t num_dests;                  // number of destinations below this branch
+  NETADDR dests[MAX_GROUP_MEMBERS];   // destinations, only num_dests are sent
+} multicast_header;
+
 typedef struct
 {
   datagram_header header;
@@ -81,10 +168,13 @@ typedef struct
 } routing_header;
 
 typedef struct {
-	CnetAddr destAddr;	// destination address
+	NETADDR destAddr;	// destination address
 	int weight;			// weight to reach destination
 	int minMTU;			// minimal MTU on path to destination
 	int minBWD;			// minimal bandwidth on path to destination
+	int delay;			// delay in usec of the fastest route to destination
+	int fastMTU;		// minimal MTU on the fastest route
+	int fastBWD;		// minimal bandwidth on the fastest route
 } DISTANCE_INFO;
 
 typedef struct
@@ -93,6 +183,29 @@ typedef struct
   DISTANCE_INFO distance_info[MAX_NEIGHBOURS];
 } ROUTING_SEGMENT;
 
+/**
+ * Maximal number of links in a link state advertisement,
+ * such that it fits into a routing segment.
+ */
+#define MAX_LSA_LINKS (MAX_NEIGHBOURS - 1)
+
+typedef struct
+{
+  CnetAddr neighbour;  // address of the node at the other end of the link
+  int      bandwidth;  // bandwidth of the link
+  int      mtu;        // MTU of the link
+  int      load;       // load of the link in per mille
+  int      weight;     // weight the node uses for the link, see get_weight()
+} LINK_STATE;
+
+typedef struct
+{
+  CnetAddr   origin;     // address of the node whose links are described
+  uint16_t   seq_num;    // sequence number of the advertisement
+  uint16_t   num_links;  // number of described links
+  LINK_STATE links[MAX_LSA_LINKS];
+} LSA;
+
 
 /* Data structures for link layer. */
 
@@ -116,6 +229,4 @@ typedef struct
   char payload[MAX_DATAGRAM_SIZE];
 } FRAME;
 
-void int2string(char* s, int i);
-
 #endif
@@ -13,6 +13,9 @@
  * the second queue if they are "larger" than elements of the first queue.
  * This is the case if they are numerically smaller AND the difference to the
  * largest element of the first queue is larger than the window size.
+ *
+ * The transport layer uses the boundary index (boundary.c) instead, the
+ * double ring is kept for the comparison in microbench/.
  */
 
 #include <stdlib.h>
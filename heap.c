@@ -0,0 +1,146 @@
+/**
+ * heap.c
+ *
+ * @autors Stefan Tombers, Alexander Bunte, Jonas Bürse
+ *
+ * Implementation of a binary min-heap.
+ *
+ * The heap stores data together with a key. The entry with the smallest key
+ * is always at the top of the heap. Insertion and removal of the top entry
+ * can be done in O(log n) where n is the number of entries in the heap.
+ * The entries are stored in an array which grows if necessary.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include "heap.h"
+
+/**
+ * Data structure for one entry of the heap.
+ */
+typedef struct HEAP_ENTRY
+{
+	int key;  // Key of the entry. It is used for sorting.
+	int data; // Data of the entry.
+} HEAP_ENTRY;
+
+
+/**
+ * Data structure for the heap.
+ */
+typedef struct _HEAP
+{
+	int len;             // Number of entries in the heap.
+	int capacity;        // Number of entries the array can hold.
+	HEAP_ENTRY *entries; // Array of the entries, entries[0] is the top.
+} _HEAP;
+
+
+/**
+ * Creates a new heap with space for 'capacity' entries.
+ *
+ * @param capacity Initial capacity of the heap.
+ * @return Handle for the created heap.
+ */
+HEAP heap_new(int capacity)
+{
+	_HEAP *heap = malloc(sizeof(*heap));
+	heap->len = 0;
+	heap->capacity = capacity > 0 ? capacity : 1;
+	heap->entries = malloc(heap->capacity * sizeof(*heap->entries));
+	return (HEAP)heap;
+}
+
+
+/**
+ * Frees all resources allocated for given heap.
+ * The handle is invalid afterwards.
+ *
+ * @param h Handle of heap to destroy.
+ */
+void heap_free(HEAP h)
+{
+	_HEAP *heap = (_HEAP *)h;
+	free(heap->entries);
+	free(heap);
+}
+
+
+/**
+ * Inserts data with the given key into the heap.
+ *
+ * @param h Handle of the heap.
+ * @param key Key of the data.
+ * @param data Data to insert.
+ */
+void heap_push(HEAP h, int key, int data)
+{
+	_HEAP *heap = (_HEAP *)h;
+
+	if (heap->len == heap->capacity) {
+		heap->capacity *= 2;
+		heap->entries = realloc(heap->entries, heap->capacity * sizeof(*heap->entries));
+	}
+
+	/* sift up */
+	int i = heap->len++;
+	while (i > 0 && heap->entries[(i - 1) / 2].key > key) {
+		heap->entries[i] = heap->entries[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	heap->entries[i].key = key;
+	heap->entries[i].data = data;
+}
+
+
+/**
+ * Removes and returns the data with the smallest key from the heap.
+ * Returns -1 if the heap is empty.
+ *
+ * @param h Handle of the heap.
+ * @param key Stores the key of the removed data, if not NULL.
+ * @return Data with the smallest key or -1 if the heap is empty.
+ */
+int heap_pop(HEAP h, int *key)
+{
+	_HEAP *heap = (_HEAP *)h;
+
+	if (heap->len == 0) {
+		return -1;
+	}
+
+	HEAP_ENTRY top = heap->entries[0];
+	HEAP_ENTRY last = heap->entries[--heap->len];
+
+	/* sift down */
+	int i = 0;
+	for (int child = 1; child < heap->len; child = 2 * i + 1) {
+		if (child + 1 < heap->len && heap->entries[child + 1].key < heap->entries[child].key) {
+			child++;
+		}
+		if (last.key <= heap->entries[child].key) {
+			break;
+		}
+		heap->entries[i] = heap->entries[child];
+		i = child;
+	}
+	heap->entries[i] = last;
+
+	if (NULL != key) {
+		*key = top.key;
+	}
+	return top.data;
+}
+
+
+/**
+ * Returns the number of entries in the heap.
+ *
+ * @param h Handle of the heap.
+ * @return Number of entries in the heap.
+ */
+int heap_nitems(HEAP h)
+{
+	_HEAP *heap = (_HEAP *)h;
+	return heap->len;
+}
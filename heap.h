@@ -0,0 +1,24 @@
+/**
+ * heap.h
+ *  
+ * @autors Stefan Tombers, Alexander Bunte, Jonas Bürse
+ *
+ * Header file for a binary min-heap.
+ */
+
+#ifndef HEAP_H_
+#define HEAP_H_
+
+typedef void * HEAP;
+
+HEAP heap_new(int capacity);
+
+void heap_free(HEAP h);
+
+void heap_push(HEAP h, int key, int data);
+
+int heap_pop(HEAP h, int *key);
+
+int heap_nitems(HEAP h);
+
+#endif
@@ -95,6 +95,7 @@ typedef struct link_t
 {
   bool     busy;                // is the link sending something?
   QUEUE    queue;               // link's output queue
+  size_t   queuedBytes;         // number of bytes in the output queue
   uint8_t  sendId;              // id of current datagram in sending process
   size_t   maxPayloadSize;      // the maximum payload sendable in one frame
   bool     corrupt;             // is current datagram corrupt
@@ -269,6 +270,7 @@ void transmit_frame(int link)
       //~ printf(" DATA transmitted: %d bytes\n", length);
       msg = queue_remove(linkData[link].queue, &length);	  
       free(msg);
+      linkData[link].queuedBytes -= length;
       timeout = transmission_delay(length, link) + LINK_DELAY;
 
 	  add_load(link, length * 8);
@@ -337,6 +339,7 @@ void link_transmit(int link, char *data, size_t size)
     processedBytes  += payloadSize;
 
     queue_add(linkData[link].queue, &frame, frameSize);
+    linkData[link].queuedBytes += frameSize;
   }
 #if SHOW_QUEUE_LENGTH == true
   printf("%lld: [queue_length]\t ", nodeinfo.time_in_usec);
@@ -516,6 +519,30 @@ int link_get_queue_size(int link)
 }
 
 
+/**
+ * Returns the time in usec a frame added to the given outgoing link
+ * has to wait until all pending frames are transmitted.
+ * @param link Link to get the queue delay for.
+ */
+CnetTime link_get_queue_delay(int link)
+{
+	assert(link <= nodeinfo.nlinks);
+	return transmission_delay(linkData[link].queuedBytes, link);
+}
+
+
+/**
+ * Returns the current delay in usec of the given outgoing link,
+ * the propagation delay plus the queue delay.
+ * @param link Link to get the delay for.
+ */
+CnetTime link_get_delay(int link)
+{
+	assert(link <= nodeinfo.nlinks);
+	return linkinfo[link].propagationdelay + link_get_queue_delay(link);
+}
+
+
 /**
  * Returns the number of direct neighbours.
  */
@@ -537,6 +564,7 @@ void link_init()
   for (int i = 0; i <= nodeinfo.nlinks; i++) {
     linkData[i].busy           = false;
     linkData[i].queue          = queue_new();
+    linkData[i].queuedBytes    = 0;
     linkData[i].sendId         = 0;
     linkData[i].maxPayloadSize = linkinfo[i].mtu - sizeof(marshaled_frame_header);
     linkData[i].corrupt        = false;
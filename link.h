@@ -16,6 +16,8 @@ float link_get_load(int link);
 int link_get_bandwidth(int link);
 int link_get_mtu(int link);
 int link_get_queue_size(int link);
+CnetTime link_get_queue_delay(int link);
+CnetTime link_get_delay(int link);
 
 int link_num_links();
 
@@ -0,0 +1,122 @@
+/**
+ * boundarybench.c
+ *
+ * @autors Stefan Tombers, Alexander Bunte, Jonas Bürse
+ *
+ * Microbenchmark of the structures storing the end offsets of received
+ * messages: the boundary index (boundary.c) and the double ring of sorted
+ * lists it replaced (dring.c).
+ *
+ * Both get the same workload as in transport_receive(): messages of random
+ * size are received with their last segments out of order within the
+ * window, and completed messages are popped in order.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <assert.h>
+#include "boundary.h"
+#include "dring.h"
+
+/**
+ * Offsets are cyclic in the transport layer (MAX_SEGMENT_OFFSET).
+ */
+#define MAX_OFFSET (1 << 18)
+
+/**
+ * Window of the transport layer (MAX_WINDOW_OFFSET).
+ */
+#define WINDOW (32 * 1024)
+
+/**
+ * Maximal size of a message, small enough that the largest backlog
+ * stays within the window.
+ */
+#define MAX_MESSAGE 2048
+
+/**
+ * Number of message ends inserted per run.
+ */
+#define NUM_MESSAGES 2000000
+
+
+/**
+ * Generates the end offsets in the order they arrive: consecutive ends
+ * are swapped within the window, as if segments were reordered.
+ */
+void generate(int *ends, int num, int window)
+{
+	long offset = 0;
+	for (int i = 0; i < num; i++) {
+		offset += 1 + rand() % MAX_MESSAGE;
+		ends[i] = offset % MAX_OFFSET;
+	}
+	for (int i = 0; i + 1 < num; i += 2) {
+		int d = (ends[i + 1] - ends[i] + MAX_OFFSET) % MAX_OFFSET;
+		if (d < window / 2 && rand() % 2) {
+			int tmp = ends[i];
+			ends[i] = ends[i + 1];
+			ends[i + 1] = tmp;
+		}
+	}
+}
+
+double seconds()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+	int *ends = malloc(NUM_MESSAGES * sizeof(*ends));
+	int *popped = malloc(NUM_MESSAGES * sizeof(*popped));
+	generate(ends, NUM_MESSAGES, WINDOW);
+
+	/* both keep up to 'backlog' ends before popping, like a receive window */
+	int backlogs[] = {1, 4, 8};
+	for (int k = 0; k < 3; k++) {
+		int backlog = backlogs[k];
+		long checksum[2] = {0, 0};
+		double time[2];
+
+		for (int impl = 0; impl < 2; impl++) {
+			BOUNDARY b = boundary_new(WINDOW, MAX_OFFSET);
+			DRING d = dring_new(WINDOW);
+			int numPopped = 0;
+
+			double start = seconds();
+			for (int i = 0; i < NUM_MESSAGES; i++) {
+				if (impl == 0) {
+					boundary_insert(b, ends[i]);
+				} else {
+					dring_insert(d, ends[i]);
+				}
+				/* pop when the pair of ends is complete and the backlog is full */
+				if (i % 2 == 1 && i / 2 % backlog == backlog - 1) {
+					int n = impl == 0 ? boundary_nitems(b) : dring_nitems(d);
+					for (int j = 0; j < n; j++) {
+						popped[numPopped++] = impl == 0 ? boundary_pop(b) : dring_pop(d);
+					}
+				}
+			}
+			time[impl] = seconds() - start;
+
+			for (int j = 0; j < numPopped; j++) {
+				checksum[impl] += (long) popped[j] * (j % 7 + 1);
+			}
+			boundary_free(b);
+			dring_free(d);
+		}
+
+		assert(checksum[0] == checksum[1]);
+		printf("backlog %2d: boundary %6.1f ns/message, dring %6.1f ns/message\n", 2 * backlog,
+		       time[0] * 1e9 / NUM_MESSAGES, time[1] * 1e9 / NUM_MESSAGES);
+	}
+
+	free(ends);
+	free(popped);
+	return 0;
+}
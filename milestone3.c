@@ -10,6 +10,34 @@
 
 #define LOAD_OUTPUT false
 
+/**
+ * If true, MULTICAST_SOURCE periodically sends a message to all hosts it
+ * sends application messages to, using network layer multicast.
+ * Used to compare multicast delivery trees with unicast fan-out
+ * (see MULTICAST_FANOUT in network.c).
+ */
+#define MULTICAST_BENCHMARK false
+
+/**
+ * Name of the node sending the multicast messages.
+ */
+#define MULTICAST_SOURCE "SB"
+
+/**
+ * Group address used for the multicast benchmark.
+ */
+#define MULTICAST_GROUP 1
+
+/**
+ * Number of cyclic outputs between two multicast messages.
+ */
+#define MULTICAST_INTERVAL 100
+
+/**
+ * Size of a multicast message.
+ */
+#define MULTICAST_SIZE 1024
+
 /* include headers */
 #include <stdlib.h>
 #include <string.h>
@@ -19,9 +47,11 @@
 #include "transport.c"
 #include "network.c"
 #include "link.c"
-#include "squeue.c"
 #include "buffer.c"
-#include "dring.c"
+#include "boundary.c"
+#include "heap.c"
+#include "addrmap.c"
+#include "congestion.c"
 
 /**
  * Message of MAX_MESSAGE_SIZE.
@@ -29,11 +59,6 @@
 char msg[MAX_MESSAGE_SIZE];
 
 
-void int2string(char* s, int i)
-{
-	sprintf(s, "%d", i);
-}
-
 
 /**
  * aplication_ready() event-handler.
@@ -47,6 +72,9 @@ static EVENT_HANDLER(application_ready)
   size_t length = sizeof(msg);
 
   CHECK(CNET_read_application(&destaddr, msg, &length));
+  #if MULTICAST_BENCHMARK == true
+  network_join_group(MULTICAST_GROUP, destaddr);
+  #endif
   transport_transmit(destaddr, msg, length);
 }
 
@@ -84,41 +112,119 @@ static EVENT_HANDLER(link_ready)
 /**
  * transport_timeout() event-handler.
  *
- * It is called whenever a timeout indicating loss of a segment occurs,
- * which means it should be retransmitted.
- * It calls <code>transmit_segment()</code>.
+ * It is called whenever the retransmission timer of a connection expires,
+ * which means its first unacknowledged segment should be retransmitted.
+ * It calls <code>transport_rto_timeout()</code>.
  */
 static EVENT_HANDLER(transport_timeout)
 {
-  transmit_segment((void *)data); // data = pointer to OUT_SEGMENT
+  transport_rto_timeout((CnetAddr) data); // data = address of the connection
 }
 
 
+/**
+ * ack_timeout() event-handler.
+ *
+ * It is called when the delayed acknowledgment of a connection is due.
+ * It calls <code>transport_ack_timeout()</code>.
+ */
+static EVENT_HANDLER(ack_timeout)
+{
+  transport_ack_timeout((CnetAddr) data); // data = address of the connection
+}
+
+
+#if USE_COALESCING == true
+/**
+ * coalesce_timeout() event-handler.
+ *
+ * It is called when a segment of a connection was held back long enough
+ * for further messages to be appended.
+ * It calls <code>transport_coalesce_timeout()</code>.
+ */
+static EVENT_HANDLER(coalesce_timeout)
+{
+  transport_coalesce_timeout((CnetAddr) data); // data = address of the connection
+}
+#endif
+
+
 /**
  * routing_timeout() event-handler.
  *
  * It is called whenever a timeout indicating loss of a routing segment occurs,
- * which means it should be retransmitted.
- * It calls <code>transmit_routing_segment()</code>.
+ * which means all unacknowledged routing segments of a neighbour should be
+ * retransmitted.
+ * It calls <code>retransmit_routing_segments()</code>.
  */
 static EVENT_HANDLER(routing_timeout)
 {
-  transmit_routing_segment((void *)data); // data = pointer to OUT_ROUTING_SEGMENT
+  retransmit_routing_segments(data); // data = link of the neighbour
+}
+
+
+/**
+ * routing_flush_timeout() event-handler.
+ *
+ * It is called when the distance updates for a neighbour have been collected
+ * long enough and should be sent as one routing segment.
+ * It calls <code>distance_flush_timeout()</code>.
+ */
+static EVENT_HANDLER(routing_flush_timeout)
+{
+  distance_flush_timeout(data); // data = link of the neighbour
+}
+
+
+/**
+ * hold_down_expired() event-handler.
+ *
+ * It is called when the hold-down of a destination ends.
+ * It calls <code>hold_down_timeout()</code> of the network layer.
+ */
+static EVENT_HANDLER(hold_down_expired)
+{
+  hold_down_timeout(data); // data = destination address
 }
 
 
 /**
- * gearing_timeout() event-handler.
+ * spf_expired() event-handler.
+ *
+ * It is called when new link state advertisements have been collected
+ * and the shortest paths should be recomputed.
+ * It calls <code>spf_timeout()</code> of the network layer.
+ */
+static EVENT_HANDLER(spf_expired)
+{
+  spf_timeout();
+}
+
+
+/**
+ * hello_expired() event-handler.
+ *
+ * It is called periodically to send hellos and detect dead neighbours.
+ * It calls <code>hello_timeout()</code> of the network layer.
+ */
+static EVENT_HANDLER(hello_expired)
+{
+  hello_timeout();
+}
+
+
+/**
+ * pacing_timeout() event-handler.
  * 
- * It is called when enough time passed to enable other messages to hand
- * some of their segments to the outgoing queues of the lower layers.
- * Now it is our turn to push the next segment down the protocol stack.
+ * It is called when enough time passed since the last segments of a
+ * connection were handed to the outgoing queues of the lower layers.
+ * Now the pacer pushes the next segments down the protocol stack.
  * 
- * It calls <code>transmit_segment()</code>.
+ * It calls <code>transport_pacing_timeout()</code>.
  */
-static EVENT_HANDLER(gearing_timeout)
+static EVENT_HANDLER(pacing_timeout)
 {
-  transmit_segment((void *)data); // data = pointer to OUT_SEGMENT
+  transport_pacing_timeout();
 }
 
 
@@ -129,6 +235,8 @@ static EVENT_HANDLER(gearing_timeout)
  */
 static EVENT_HANDLER(cyclic_output_timeout)
 {
+	bool restart = false;
+
 	#if LOGGING == true
 	#if LOAD_OUTPUT == true
 	for (int i = 1; i <= nodeinfo.nlinks; i++) {
@@ -138,10 +246,34 @@ static EVENT_HANDLER(cyclic_output_timeout)
 		printf("%lld: [load_output] on_link: %d load: %f\n\n", nodeinfo.time_in_usec, i, load);
 		
 	}
-	CNET_start_timer(CYCLIC_OUTPUT_TIMER, (CnetTime) 1000, (CnetData) NULL);
+	restart = true;
 	#endif
 	#endif
-	
+
+	#if MULTICAST_BENCHMARK == true
+	if (strcmp(nodeinfo.nodename, MULTICAST_SOURCE) == 0) {
+		if (data % MULTICAST_INTERVAL == 0) {
+			network_transmit_multicast(MULTICAST_GROUP, msg, MULTICAST_SIZE);
+		}
+		restart = true;
+	}
+	#endif
+
+	if (restart) {
+		CNET_start_timer(CYCLIC_OUTPUT_TIMER, (CnetTime) 1000, data + 1);
+	}
+}
+
+
+/**
+ * shutdown_node() event-handler.
+ *
+ * It is called when the simulation ends.
+ * It calls <code>transport_shutdown()</code>, which prints statistics.
+ */
+static EVENT_HANDLER(shutdown_node)
+{
+	transport_shutdown();
 }
 
 
@@ -157,13 +289,22 @@ EVENT_HANDLER(reboot_node)
 	CHECK(CNET_set_handler(EV_PHYSICALREADY,    physical_ready, 0));
 	CHECK(CNET_set_handler(LINK_TIMER,          link_ready, 0));
 	CHECK(CNET_set_handler(TRANSPORT_TIMER,     transport_timeout, 0));
+	CHECK(CNET_set_handler(ACK_TIMER,           ack_timeout, 0));
+	#if USE_COALESCING == true
+	CHECK(CNET_set_handler(COALESCE_TIMER,      coalesce_timeout, 0));
+	#endif
 	CHECK(CNET_set_handler(ROUTING_TIMER,		routing_timeout, 0));
-	CHECK(CNET_set_handler(GEARING_TIMER,		gearing_timeout, 0));
+	CHECK(CNET_set_handler(ROUTING_FLUSH_TIMER,	routing_flush_timeout, 0));
+	CHECK(CNET_set_handler(HOLD_DOWN_TIMER,		hold_down_expired, 0));
+	CHECK(CNET_set_handler(SPF_TIMER,		spf_expired, 0));
+	CHECK(CNET_set_handler(HELLO_TIMER,		hello_expired, 0));
+	CHECK(CNET_set_handler(PACING_TIMER,		pacing_timeout, 0));
 	CHECK(CNET_set_handler(CYCLIC_OUTPUT_TIMER,	cyclic_output_timeout, 0));
+	CHECK(CNET_set_handler(EV_SHUTDOWN,		shutdown_node, 0));
 
 	link_init();
 	network_init();
 	transport_init();
 
-	CNET_start_timer(CYCLIC_OUTPUT_TIMER, (CnetTime) 1000, (CnetData) NULL);
+	CNET_start_timer(CYCLIC_OUTPUT_TIMER, (CnetTime) 1000, (CnetData) 0);
 }
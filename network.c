@@ -16,19 +16,35 @@
  * This contains the link numbers with the smallest route weight for each address.
  *
  * For each datagram it is checked if it is "normal" data or a routing packet.
+ *
+ * Multicast datagrams carry the list of their destinations. Each node splits
+ * the list by next hop and sends one copy per next hop, such that datagrams
+ * are only duplicated where the routes to the destinations branch.
+ *
+ * The forwarding table is either built by a distance vector algorithm or,
+ * if USE_LINK_STATE is set, by a link-state algorithm. The distance vector
+ * algorithm can start from routes precomputed by the route compiler.
+ * Neighbours are watched by hellos; routes over a dead neighbour are
+ * replaced by the next best ones at once.
  */
 
 /* include headers */
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <assert.h>
 #include <limits.h>
+#include <stdio.h>
+#include <math.h>
 #include <cnet.h>
 #include <cnetsupport.h>
 #include "datatypes.h"
 #include "link.h"
 #include "network.h"
 #include "transport.h"
+#include "heap.h"
+#include "addrmap.h"
+#include "weights.h"
 
 
 /**
@@ -36,6 +52,104 @@
  */
 #define HOP_LIMIT 32
 
+/**
+ * Time in usec a destination is held down after its route got worse.
+ */
+#define HOLD_DOWN_TIME 500000
+
+/**
+ * If true, a route is advertised as unreachable to the neighbour it was
+ * learned from (split horizon with poisoned reverse).
+ */
+#define USE_SPLIT_HORIZON true
+
+/**
+ * If true, alternative routes which are not better than a lost route are
+ * ignored for HOLD_DOWN_TIME.
+ */
+#define USE_HOLD_DOWN true
+
+/**
+ * If true, the forwarding table is computed from flooded link state
+ * advertisements instead of distance vectors.
+ */
+#define USE_LINK_STATE false
+
+/**
+ * If true, datagrams are marked when they are queued behind a congested
+ * link and the transport layer adapts its window (ECN).
+ */
+#define USE_ECN true
+
+/**
+ * Queue delay in usec above which an outgoing link is considered congested.
+ */
+#define ECN_QUEUE_DELAY 20000
+
+/**
+ * If true, multicast datagrams are sent to every member separately
+ * (unicast fan-out), for comparison with multicast delivery trees.
+ */
+#define MULTICAST_FANOUT false
+
+/**
+ * If true, the transport layer is notified whenever the route to a
+ * destination changes, so it can adapt its connection right away.
+ */
+#define USE_ROUTE_NOTIFY true
+
+/**
+ * If true, changes of the forwarding table and routing traffic are logged
+ * for evaluation of the routing algorithm (see benchmark.sh).
+ */
+#define ROUTING_STATS false
+
+/**
+ * If true, the routing table is loaded from ROUTE_FILE at boot (see the
+ * route compiler in routes/) and the distance vector algorithm only
+ * propagates changes. Without a matching file the node starts cold.
+ */
+#define USE_ROUTE_FILE true
+
+/**
+ * Route file written by the route compiler for the simulated topology.
+ */
+#define ROUTE_FILE "routes.bin"
+
+/**
+ * Version of the route file format, must match the route compiler.
+ */
+#define ROUTE_FILE_VERSION 6
+
+/**
+ * If true, the link weights in WEIGHT_FILE replace the bandwidth based
+ * ones of get_weight() (see the weight optimizer in routes/).
+ */
+#define USE_WEIGHT_FILE true
+
+/**
+ * Weight file written by the weight optimizer for the simulated topology.
+ * Each line holds an address, a link number and the weight of the link.
+ */
+#define WEIGHT_FILE "weights.txt"
+
+/**
+ * If true, neighbours which stay silent for DEAD_INTERVAL are considered
+ * dead and their routes are replaced by the next best ones.
+ */
+#define USE_HELLO true
+
+/**
+ * Time in usec after which a link without outgoing traffic gets a hello.
+ */
+#define HELLO_INTERVAL 200000
+
+/**
+ * Time in usec without any datagram from a neighbour until it is
+ * considered dead.
+ */
+#define DEAD_INTERVAL 1000000
+
 /**
  * An entry of the routing table.
  */
@@ -43,22 +157,50 @@ typedef struct {
 	int weight;			// weight to reach destination
 	int minMTU;			// minimal MTU on path to destination
 	int minBWD;			// minimal bandwidth on path to destination
+	int delay;			// delay of the fastest route to destination
+	int fastMTU;		// minimal MTU on the fastest route
+	int fastBWD;		// minimal bandwidth on the fastest route
 } ROUTING_ENTRY;
 
+/**
+ * An entry of the forwarding table, the next hop for each traffic class.
+ */
+typedef struct {
+	int link[NUM_TRAFFIC_CLASSES];	// next hop
+} FORWARDING_ENTRY;
+
+/**
+ * Members of a multicast group.
+ */
+typedef struct {
+	int num_members;			// number of members
+	CnetAddr members[MAX_GROUP_MEMBERS];	// addresses of the members
+} GROUP;
+
+/**
+ * Hold-down state of a destination whose route got worse.
+ */
+typedef struct {
+	int weight;			// weight of the lost route
+	int link;				// link the lost route was using
+} HOLD_DOWN;
+
 
-void int2string(char* s, int i);
 void routing_init();
-void routing_receive(int link, char *data, size_t size);
+void routing_receive(int link, CnetAddr srcaddr, char *data, size_t size);
 ROUTING_ENTRY *routing_lookup(CnetAddr addr);
-void update_forwarding_table(CnetAddr destAddr, int nextHop);
+ROUTING_ENTRY *routing_add(CnetAddr addr);
+void update_forwarding_table(CnetAddr destAddr, int nextHop, int fastHop);
+void neighbour_heard(int link);
+void neighbour_sent(int link);
 
 
 /**
  * Stores which route a packet should travel for a given destination.
  *
- * destination address -> next hop
+ * destination address -> FORWARDING_ENTRY
  */
-HASHTABLE forwarding_table;
+ADDRMAP forwarding_table;
 
 /**
  * Stores the distance information for each destination relative to
@@ -66,7 +208,36 @@ HASHTABLE forwarding_table;
  *
  * destination address, outgoing link -> ROUTING_ENTRY
  */
-HASHTABLE routing_table;
+ADDRMAP routing_table;
+
+/**
+ * Stores the destinations which are currently held down.
+ *
+ * destination address -> HOLD_DOWN
+ */
+ADDRMAP hold_down_table;
+
+/**
+ * Stores the members of the multicast groups this node sends to.
+ *
+ * group address -> GROUP
+ */
+ADDRMAP groups;
+
+
+/**
+ * Marks a datagram as congested if the queue of the outgoing link
+ * is congested.
+ *
+ * @param header Header of the datagram.
+ * @param link Link the datagram is sent on.
+ */
+void mark_congestion(datagram_header *header, int link)
+{
+	if(USE_ECN && link_get_queue_delay(link) > ECN_QUEUE_DELAY) {
+		header->congested = true;
+	}
+}
 
 
 /**
@@ -75,42 +246,179 @@ HASHTABLE routing_table;
  * 
  * @param link    Link to send the segment on.
  * @param routing Segment contains routing data.
+ * @param tclass  Traffic class of the segment.
  * @param addr    Destination address.
  * @param data    Segment to send.
  * @param size    Size of segment.
  */
-void transmit_datagram(int link, bool routing, CnetAddr addr, char *data, size_t size)
+void transmit_datagram(int link, bool routing, int tclass, CnetAddr addr, char *data, size_t size)
 {
 	/* datagram header */
 	datagram_header header;
 	header.srcaddr = nodeinfo.address;
 	header.destaddr = addr;
 	header.hoplimit = HOP_LIMIT;
+	header.tclass = tclass;
 	header.routing = routing;
+	header.multicast = false;
+	header.congested = false;
+	if(!routing) {
+		mark_congestion(&header, link);
+	}
 
 	/* assemble datagram */
 	DATAGRAM datagram;
 	datagram.header = header;
 	memcpy(&datagram.payload, data, size);
 	size_t datagramSize = size + sizeof(datagram_header);
+	#if ROUTING_STATS == true
+	if(routing) {
+		printf("%lld: [routing_datagram] link: %d size: %d\n", nodeinfo.time_in_usec, link, (int) datagramSize);
+	}
+	#endif
 	/* send datagram */
+	neighbour_sent(link);
 	link_transmit(link, (char*) &datagram, datagramSize);
 }
 
 
 /**
- * Takes a segment and delivers it to addr.
+ * Takes a segment and delivers it to addr on the route of its traffic class.
  * 
  * @param addr Destination address.
+ * @param tclass Traffic class of the segment.
  * @param data Segment to send.
  * @param size Size of segment.
  */
-void network_transmit(CnetAddr addr, char *data, size_t size)
+void network_transmit(CnetAddr addr, int tclass, char *data, size_t size)
 {
-	int link = network_lookup(addr);
+	int link = network_lookup_class(addr, tclass);
 	if (link > -1) {
-		transmit_datagram(link, false, addr, data, size);
+		transmit_datagram(link, false, tclass, addr, data, size);
+	}
+}
+
+
+/**
+ * Delivers multicast data to a list of destinations.
+ *
+ * If this node is a destination, the data are handed to
+ * transport_receive_multicast(), which does not pass them on to the
+ * application (multicast ends at the network layer). The other
+ * destinations are grouped by their next hop and one datagram is sent per
+ * next hop, carrying only the destinations reachable over it.
+ * 
+ * @param srcaddr Source address.
+ * @param group Group address.
+ * @param hoplimit Hop limit of the outgoing datagrams.
+ * @param dests Destination addresses.
+ * @param num_dests Number of destinations.
+ * @param data Multicast data.
+ * @param size Size of multicast data.
+ */
+void forward_multicast(CnetAddr srcaddr, CnetAddr group, int hoplimit,
+											 NETADDR *dests, int num_dests, char *data, size_t size)
+{
+	int links[num_dests];
+
+	for(int i = 0; i < num_dests; i++) {
+		links[i] = (dests[i] == nodeinfo.address) ? 0 : network_lookup(dests[i]);
+		if(links[i] == 0) {
+			transport_receive_multicast(srcaddr, group, data, size);
+		}
+	}
+
+	for(int i = 0; i < num_dests; i++) {
+		if(links[i] <= 0) {
+			continue; // delivered, unreachable or already sent
+		}
+
+		/* one datagram for all destinations behind this link */
+		DATAGRAM datagram;
+		multicast_header *mHeader = (multicast_header *) datagram.payload;
+		int link = links[i];
+		mHeader->num_dests = 0;
+		for(int j = i; j < num_dests; j++) {
+			if(links[j] == link) {
+				mHeader->dests[mHeader->num_dests++] = dests[j];
+				links[j] = -1;
+			}
+		}
+
+		size_t headerSize = offsetof(multicast_header, dests) + mHeader->num_dests * sizeof(NETADDR);
+		assert(headerSize + size <= sizeof(datagram.payload));
+		memcpy(datagram.payload + headerSize, data, size);
+
+		datagram.header.srcaddr = srcaddr;
+		datagram.header.destaddr = group;
+		datagram.header.hoplimit = hoplimit;
+		datagram.header.tclass = CLASS_BULK;
+		datagram.header.routing = false;
+		datagram.header.multicast = true;
+		datagram.header.congested = false;
+		size_t datagramSize = sizeof(datagram_header) + headerSize + size;
+
+		#if ROUTING_STATS == true
+		printf("%lld: [multicast_datagram] link: %d dests: %d size: %d\n",
+					 nodeinfo.time_in_usec, link, mHeader->num_dests, (int) datagramSize);
+		#endif
+		neighbour_sent(link);
+		link_transmit(link, (char*) &datagram, datagramSize);
+	}
+}
+
+
+/**
+ * Adds a member to a multicast group.
+ * 
+ * @param group Group address.
+ * @param member Address of the new member.
+ */
+void network_join_group(CnetAddr group, CnetAddr member)
+{
+	GROUP *g = addrmap_find(groups, group);
+
+	if(NULL == g) {
+		g = addrmap_add(groups, group, NULL);
+	}
+
+	for(int i = 0; i < g->num_members; i++) {
+		if(g->members[i] == member) {
+			return;
+		}
+	}
+	assert(g->num_members < MAX_GROUP_MEMBERS);
+	g->members[g->num_members++] = member;
+}
+
+
+/**
+ * Takes data and delivers it to all members of a multicast group.
+ * 
+ * @param group Group address.
+ * @param data Data to send.
+ * @param size Size of data.
+ */
+void network_transmit_multicast(CnetAddr group, char *data, size_t size)
+{
+	GROUP *g = addrmap_find(groups, group);
+
+	if(NULL == g) {
+		return;
+	}
+
+	NETADDR dests[MAX_GROUP_MEMBERS];
+	for(int i = 0; i < g->num_members; i++) {
+		dests[i] = g->members[i];
 	}
+
+	#if MULTICAST_FANOUT == true
+	for(int i = 0; i < g->num_members; i++) {
+		forward_multicast(nodeinfo.address, group, HOP_LIMIT, &dests[i], 1, data, size);
+	}
+	#else
+	forward_multicast(nodeinfo.address, group, HOP_LIMIT, dests, g->num_members, data, size);
+	#endif
 }
 
 
@@ -129,25 +437,42 @@ void network_receive(int link, char *data, size_t size)
 	CnetAddr srcaddr = datagram->header.srcaddr;
 	CnetAddr destaddr = datagram->header.destaddr;
 
+	/* any datagram shows that the neighbour is alive */
+	neighbour_heard(link);
+
 	if(0 >= datagram->header.hoplimit)
 		return; //hoplimit exceeded -> drop data
 
 	if (datagram->header.routing) {
-		routing_receive(link, datagram->payload, size);
+		size_t segmentSize = size - sizeof(datagram_header);
+		routing_receive(link, srcaddr, datagram->payload, segmentSize);
+	}
+	else if (datagram->header.multicast) {
+		/* deliver and branch towards the remaining destinations */
+		multicast_header *mHeader = (multicast_header *) datagram->payload;
+		size_t headerSize = offsetof(multicast_header, dests) + mHeader->num_dests * sizeof(NETADDR);
+		forward_multicast(srcaddr, destaddr, datagram->header.hoplimit - 1,
+											mHeader->dests, mHeader->num_dests, datagram->payload + headerSize,
+											size - sizeof(datagram_header) - headerSize);
 	}
 	else if(nodeinfo.address == destaddr) {
 		/* datagram destination = this node -> hand to upper layer */
 		assert(!datagram->header.routing);
 		char* segment = datagram->payload;
 		size_t segmentSize = size - sizeof(datagram_header);
-		transport_receive(srcaddr, segment, segmentSize);
+		transport_receive(srcaddr, segment, segmentSize, datagram->header.congested);
 	}
 	else {
 		/* datagram destination = foreign node -> forward */
-		int link = network_lookup(destaddr);
-
-		datagram->header.hoplimit--;
-		link_transmit(link, (char*) datagram, size);
+		int tclass = datagram->header.tclass < NUM_TRAFFIC_CLASSES ? datagram->header.tclass : CLASS_BULK;
+		int link = network_lookup_class(destaddr, tclass);
+
+		if(link > -1) {
+			datagram->header.hoplimit--;
+			mark_congestion(&datagram->header, link);
+			neighbour_sent(link);
+			link_transmit(link, (char*) datagram, size);
+		}
 	}
 }
 
@@ -159,24 +484,38 @@ void network_receive(int link, char *data, size_t size)
  */
 void network_init()
 {
-	forwarding_table = hashtable_new(0);
+	forwarding_table = addrmap_new(sizeof(FORWARDING_ENTRY));
+	groups = addrmap_new(sizeof(GROUP));
 
 	routing_init();
 }
 
 
 /**
- * Lookup link in forwarding_table and returns the corresponding link.
+ * Lookup link in forwarding_table and returns the corresponding link
+ * for the given traffic class.
+ *
+ * @param addr The address to look up.
+ * @param tclass The traffic class.
+ * @return The link to send the data over.
+ */
+int network_lookup_class(CnetAddr addr, int tclass)
+{
+	FORWARDING_ENTRY *entry = addrmap_find(forwarding_table, addr);
+	return (entry != NULL) ? entry->link[tclass] : -1;
+}
+
+
+/**
+ * Lookup link in forwarding_table and returns the corresponding link
+ * for bulk traffic.
  *
  * @param addr The address to look up.
  * @return The link to send the data over.
  */
 int network_lookup(CnetAddr addr)
 {
-	char key[5];
-	int2string(key, addr);
-	int *link = hashtable_find(forwarding_table, key, NULL);
-	return (link != NULL) ? *link : -1;
+	return network_lookup_class(addr, CLASS_BULK);
 }
 
 
@@ -192,17 +531,78 @@ CnetAddr network_get_address()
 
 
 /**
- * Returns minimum bandwidth on route to addr.
+ * Returns whether traffic of class 'tclass' takes the fastest route
+ * over 'link', rather than the bulk route.
+ *
+ * @param entry Routing table entry of the destination.
+ * @param link Link the traffic is forwarded on.
+ * @param tclass The traffic class.
+ */
+bool takes_fastest_route(ROUTING_ENTRY *entry, int link, int tclass)
+{
+	/* without a fastest route latency traffic takes the bulk route */
+	return tclass == CLASS_LATENCY && entry[link].delay < ROUTING_INFINITY;
+}
+
+
+/**
+ * Returns minimum bandwidth on the route traffic of the given class
+ * takes to addr.
  * 
  * @param addr The destination address.
+ * @param tclass The traffic class.
  * @return Minimum bandwidth on route to addr.
  */
-int network_get_bandwidth(CnetAddr addr)
+int network_get_bandwidth(CnetAddr addr, int tclass)
 {
-	int link             = network_lookup(addr);
+	int link             = network_lookup_class(addr, tclass);
 	ROUTING_ENTRY *entry = routing_lookup(addr);
-	
-	return entry[link].minBWD;
+
+	if(link < 0 || NULL == entry) {
+		return 0; // unreachable
+	}
+	return takes_fastest_route(entry, link, tclass) ? entry[link].fastBWD : entry[link].minBWD;
+}
+
+
+/**
+ * Returns the size of the largest segment which can be sent to addr
+ * without being split into several frames on any link of the route
+ * traffic of the given class takes. Returns 0 if addr is unreachable.
+ * 
+ * @param addr The destination address.
+ * @param tclass The traffic class.
+ * @return Maximal segment size on the route to addr.
+ */
+int network_get_mtu(CnetAddr addr, int tclass)
+{
+	int link             = network_lookup_class(addr, tclass);
+	ROUTING_ENTRY *entry = routing_lookup(addr);
+
+	if(link < 0 || NULL == entry) {
+		return 0; // unreachable
+	}
+	int mtu = takes_fastest_route(entry, link, tclass) ? entry[link].fastMTU : entry[link].minMTU;
+	return mtu - sizeof(marshaled_frame_header) - sizeof(datagram_header);
+}
+
+
+/**
+ * Returns the time the frames queued on the first link of the route to
+ * addr need to be transmitted. Returns 0 if addr is unreachable.
+ *
+ * @param addr The destination address.
+ * @param tclass The traffic class of the data.
+ * @return Queue delay in usec on the first link of the route.
+ */
+CnetTime network_get_queue_delay(CnetAddr addr, int tclass)
+{
+	int link = network_lookup_class(addr, tclass);
+
+	if(link <= 0) {
+		return 0; // unreachable or local
+	}
+	return link_get_queue_delay(link);
 }
 
 
@@ -215,21 +615,70 @@ int network_get_bandwidth(CnetAddr addr)
  */
 #define ROUTING_TIMEOUT 100000
 
+/**
+ * Time in usec distance updates for a neighbour are collected
+ * before they are sent as one routing segment.
+ */
+#define ROUTING_COALESCE_TIME 5000
+
+
+/**
+ * Maximal timeout in usec when routing segments are resent after
+ * repeated losses.
+ */
+#define ROUTING_MAX_TIMEOUT 3200000
+
+/**
+ * Initial number of routing segments a neighbour's ring buffer can hold.
+ */
+#define ROUTING_RING_SIZE 4
+
+/**
+ * Maximal size of one distance information on the wire.
+ * A compact one has up to 3 bytes of address delta and 6 bytes of codes.
+ */
+#if USE_COMPACT_ROUTING == true
+#define DISTANCE_INFO_WIRE_SIZE 9
+#else
+#define DISTANCE_INFO_WIRE_SIZE sizeof(DISTANCE_INFO)
+#endif
+
+/**
+ * Codes per doubling of the bandwidth.
+ */
+#define BANDWIDTH_CODES_PER_OCTAVE 8
+
+/**
+ * If true, every encoded distance information is decoded again
+ * and compared with the original, see check_distance_info().
+ */
+#define CHECK_COMPACT_ROUTING false
+
 
 typedef struct
 {
-	VECTOR outRoutingSegments;		// Sent routing segements.
-	size_t nextSeqNum;     		    // Sequence number for next routing segment.
-	size_t nextAckNum;						// The next awaited sequence number. Initially it is 0.
-} NEIGHBOUR;
+	size_t size;              // Size of the out routing segment.
+	ROUTING_SEGMENT rSeg;     // The routing segment.
+} OUT_ROUTING_SEGMENT;
 
 typedef struct
 {
-	CnetTimerID timerId; 			// The ID of the timer to count the timeout.
-	int link;       	 				// The destination link for the routing segment.
-	size_t size;         			// Size of the out routing segment.
-	ROUTING_SEGMENT *rSeg;		// Pointer to the routing segment.
-} OUT_ROUTING_SEGMENT;
+	OUT_ROUTING_SEGMENT *outRoutingSegments; // Ring buffer of sent, unacknowledged routing segments.
+	int outCapacity;              // Number of slots of the ring buffer.
+	int outFirst;                 // Slot of the oldest unacknowledged routing segment.
+	int outCount;                 // Number of unacknowledged routing segments.
+	CnetTimerID timerId;          // Retransmission timer, -1 if not running.
+	CnetTime timeout;             // Current retransmission timeout.
+	uint16_t nextSeqNum;          // Sequence number for next routing segment, wraps like seq_num.
+	uint16_t nextAckNum;          // The next awaited sequence number, wraps like seq_num. Initially it is 0.
+	DISTANCE_INFO pending[MAX_NEIGHBOURS]; // Distance updates not yet sent to the neighbour.
+	int numPending;               // Number of entries in pending.
+	bool ackPending;              // Received routing segments are not acknowledged yet.
+	CnetTimerID flushTimerId;     // Timer flushing the pending updates, -1 if not running.
+	bool alive;                   // Whether the neighbour was heard within DEAD_INTERVAL.
+	CnetTime lastHeard;           // Time the last datagram was received from the neighbour.
+	CnetTime lastSent;            // Time the last datagram was sent to the neighbour.
+} NEIGHBOUR;
 
 
 /**
@@ -238,281 +687,1876 @@ typedef struct
  */
 NEIGHBOUR *neighbours;
 
+/**
+ * Addresses of all destinations in the routing table.
+ */
+VECTOR destinations;
+
+/**
+ * Weight of each link loaded from WEIGHT_FILE, -1 for bandwidth based.
+ */
+int *link_weights;
+
 
 bool update_routing_table(int link, DISTANCE_INFO inDistInfo, DISTANCE_INFO *outDistInfo);
+bool select_route(CnetAddr destAddr, ROUTING_ENTRY *entry, int oldChoice,
+									ROUTING_ENTRY oldBest, DISTANCE_INFO *outDistInfo);
+ROUTING_ENTRY current_route(CnetAddr destAddr, ROUTING_ENTRY *entry);
 int get_weight(int link);
+void transmit_distance_ack(int link);
+void linkstate_init();
+void linkstate_receive(int link, CnetAddr srcaddr, char *data, size_t size);
+void linkstate_neighbour_down(int link);
 
 
 /**
- * Hands routing segment to the link layer (!) and starts timer.
+ * Hands routing segment to the link layer (!).
+ * The current acknowledgment is piggybacked.
  * 
+ * @param link Link to send the routing segment on.
  * @param outSeg Routing segment to transmit.
  */
-void transmit_routing_segment(OUT_ROUTING_SEGMENT *outSeg)
+void transmit_routing_segment(int link, OUT_ROUTING_SEGMENT *outSeg)
 {
-	outSeg->rSeg->header.ack_num = neighbours[outSeg->link].nextAckNum;
-	transmit_datagram(outSeg->link, true, 0, (char *)outSeg->rSeg, outSeg->size);
-	outSeg->timerId = CNET_start_timer(ROUTING_TIMER, ROUTING_TIMEOUT, (CnetData) outSeg);
+	outSeg->rSeg.header.ack_num = neighbours[link].nextAckNum;
+	neighbours[link].ackPending = false;
+	transmit_datagram(link, true, CLASS_LATENCY, 0, (char *)&outSeg->rSeg, outSeg->size);
 }
 
 
 /**
- * Packs distance information and an outgoing link
- * as a routing segment and delivers it.
+ * (Re)starts the retransmission timer of a neighbour.
  *
- * @param distance_info Distance information to send.
- * @param size Size of distance information.
- * @param link Link to send the distance information on.
+ * @param link Link of the neighbour.
  */
-void transmit_distance_info(DISTANCE_INFO *distance_info, size_t size, int link)
+void restart_routing_timer(int link)
 {
 	NEIGHBOUR *nb = &neighbours[link];
 
-	ROUTING_SEGMENT *rSeg = malloc(sizeof(*rSeg));
-	rSeg->header.seq_num = nb->nextSeqNum++;
-	rSeg->header.ack_num = nb->nextAckNum;
-	memcpy(rSeg->distance_info, distance_info, size);
+	if(nb->timerId != -1) {
+		CNET_stop_timer(nb->timerId);
+	}
+	nb->timerId = CNET_start_timer(ROUTING_TIMER, nb->timeout, (CnetData) link);
+}
+
 
-	OUT_ROUTING_SEGMENT *outSeg = malloc(sizeof(*outSeg));
-	outSeg->link = link;
-	outSeg->rSeg = rSeg;
-	outSeg->size = size + sizeof(routing_header);
+/**
+ * Resends all unacknowledged routing segments of a neighbour.
+ * Called when the retransmission timer of the neighbour expired.
+ * The timeout is doubled up to ROUTING_MAX_TIMEOUT.
+ *
+ * @param link Link of the neighbour.
+ */
+void retransmit_routing_segments(int link)
+{
+	NEIGHBOUR *nb = &neighbours[link];
+	nb->timerId = -1;
 
-	int pos = vector_nitems(nb->outRoutingSegments);
-	vector_append(nb->outRoutingSegments, outSeg, sizeof(*outSeg));
-	free(outSeg);
-	outSeg = vector_peek(nb->outRoutingSegments, pos, NULL);
+	for(int i = 0; i < nb->outCount; i++) {
+		transmit_routing_segment(link, &nb->outRoutingSegments[(nb->outFirst + i) % nb->outCapacity]);
+	}
 
-	transmit_routing_segment(outSeg);
+	if(nb->outCount > 0) {
+		nb->timeout = MIN(2 * nb->timeout, ROUTING_MAX_TIMEOUT);
+		restart_routing_timer(link);
+	}
 }
 
 
 /**
- * Broadcasts the given distance information to all neigbours.
+ * Returns a free slot at the end of a neighbour's ring buffer.
+ * The ring buffer grows if it is full.
  *
- * @param distance_info Distance information to send.
- * @param size Size of distance information.
+ * @param nb The neighbour.
+ * @return Free slot for a routing segment.
  */
-void broadcast_distance_info(DISTANCE_INFO *distance_info, size_t size)
+OUT_ROUTING_SEGMENT *routing_ring_append(NEIGHBOUR *nb)
 {
-	int num_neighbours = link_num_links();
-
-	for(int i=1; i<=num_neighbours; i++) {
-		transmit_distance_info(distance_info, size, i);
+	if(nb->outCount == nb->outCapacity) {
+		/* double capacity and unwrap the ring */
+		OUT_ROUTING_SEGMENT *ring = malloc(2 * nb->outCapacity * sizeof(*ring));
+		for(int i = 0; i < nb->outCount; i++) {
+			ring[i] = nb->outRoutingSegments[(nb->outFirst + i) % nb->outCapacity];
+		}
+		free(nb->outRoutingSegments);
+		nb->outRoutingSegments = ring;
+		nb->outCapacity *= 2;
+		nb->outFirst = 0;
 	}
+
+	return &nb->outRoutingSegments[(nb->outFirst + nb->outCount++) % nb->outCapacity];
 }
 
 
 /**
- * Acknowledges received distance info.
+ * Packs routing data and an outgoing link
+ * as a routing segment and delivers it reliably.
  *
- * @param link Link to send the acknowledgment on.
+ * @param data Routing data to send.
+ * @param size Size of the routing data.
+ * @param link Link to send the routing data on.
  */
-void transmit_distance_ack(int link)
+void transmit_routing_data(char *data, size_t size, int link)
 {
 	NEIGHBOUR *nb = &neighbours[link];
 
-	ROUTING_SEGMENT rSeg;
-	rSeg.header.seq_num = 0;
-	rSeg.header.ack_num = nb->nextAckNum;
+	OUT_ROUTING_SEGMENT *outSeg = routing_ring_append(nb);
+	assert(size <= sizeof(outSeg->rSeg.distance_info));
+	outSeg->rSeg.header.seq_num = nb->nextSeqNum++;
+	memcpy(outSeg->rSeg.distance_info, data, size);
+	outSeg->size = size + sizeof(routing_header);
+
+	transmit_routing_segment(link, outSeg);
 
-	transmit_datagram(link, true, 0, (char *)&rSeg, sizeof(routing_header));
+	if(nb->timerId == -1) {
+		nb->timeout = ROUTING_TIMEOUT;
+		restart_routing_timer(link);
+	}
 }
 
 
 /**
- * Receive a routing segment.
- *
- * Reads the routing information from the routing segment,
- * changes the routing table accordingly and potentially broadcasts,
- * changes in forwarding decisions.
- * Drops all out of order routing segments (relies on ordered resend).
- * 
- * @param link Link which received the routing segment.
- * @param data The received routing segment.
- * @param size Size of the routing segment.
+ * Decoded values of the compact weight and bandwidth codes.
+ * Filled by compact_init().
+ */
+int weight_codes[COMPACT_MAX_CODE + 1];
+int bandwidth_codes[COMPACT_MAX_CODE + 1];
+
+/**
+ * MTU classes of the compact encoding, the code is the index.
  */
-void routing_receive(int link, char *data, size_t size)
+const int mtu_codes[] = {0, 96, 128, 256, 512, 576, 1024, 1280, 1500, 2048,
+												 4096, 8192, 9000, 16384, 32768, INT_MAX};
+#define NUM_MTU_CODES (sizeof(mtu_codes) / sizeof(mtu_codes[0]))
+
+
+/**
+ * Fills the tables of the compact encoding. Both tables are ascending.
+ */
+void compact_init()
 {
-	ROUTING_SEGMENT *rSeg = (ROUTING_SEGMENT *)data;
-	NEIGHBOUR *nb = &neighbours[link];
+	for(int c = 0; c < COMPACT_MAX_CODE; c++) {
+		weight_codes[c] = weight_code_value(c);
 
-	/* process acknowledgement */
-	for (OUT_ROUTING_SEGMENT *ackSeg = vector_peek(nb->outRoutingSegments, 0, NULL);
-			 vector_nitems(nb->outRoutingSegments)
-				&& ackSeg->rSeg->header.seq_num < rSeg->header.ack_num;
-			 ackSeg = vector_peek(nb->outRoutingSegments, 0, NULL))
-	{
-		vector_remove(nb->outRoutingSegments, 0, NULL);
-		CNET_stop_timer(ackSeg->timerId);
-		free(ackSeg->rSeg);
-		free(ackSeg);
+		double bandwidth = floor(pow(2., (double) c / BANDWIDTH_CODES_PER_OCTAVE));
+		bandwidth_codes[c] = bandwidth < INT_MAX ? bandwidth : INT_MAX;
 	}
+	weight_codes[COMPACT_MAX_CODE] = ROUTING_INFINITY;
+	bandwidth_codes[COMPACT_MAX_CODE] = INT_MAX;
+}
 
-	int distInfoLength = (size - sizeof(routing_header)) / sizeof(DISTANCE_INFO);
 
-	if(nb->nextAckNum == rSeg->header.seq_num) { // in order
-		/* process routing information */
-		int updates = 0;
-		DISTANCE_INFO sendDistInfo[distInfoLength];
-		nb->nextAckNum++;
+/**
+ * Returns the smallest code whose value is at least 'value',
+ * the largest one if 'roundUp' is false.
+ *
+ * @param codes Ascending table of the code values.
+ * @param num Number of codes.
+ * @param value Value to encode.
+ * @param roundUp Whether to round up or down.
+ */
+int compact_code(const int *codes, int num, int value, bool roundUp)
+{
+	int low = 0, high = num - 1;
 
-		for(int i=0; i<distInfoLength; i++) {
-			DISTANCE_INFO distInfo = rSeg->distance_info[i];
-			if(distInfo.destAddr != nodeinfo.address
-				&& update_routing_table(link, distInfo, &(sendDistInfo[updates]))) {
-				updates++;
+	/* binary search for the first code >= value */
+	while(low < high) {
+		int mid = (low + high) / 2;
+		if(codes[mid] < value) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	if(!roundUp && codes[low] > value && low > 0) {
+		low--;
+	}
+	return low;
+}
+
+
+/**
+ * Compares distance information by destination address for qsort().
+ */
+int compare_dest_addr(const void *a, const void *b)
+{
+	return ((DISTANCE_INFO *) a)->destAddr - ((DISTANCE_INFO *) b)->destAddr;
+}
+
+
+/**
+ * Encodes distance information for a routing segment and returns its size.
+ *
+ * In the compact encoding the entries are sorted by address, each address
+ * is sent as varint of the difference to the previous one, followed by
+ * one byte codes of weight, delay, bandwidth and MTU of the bulk route
+ * and bandwidth and MTU of the fastest route. Weights and delays
+ * are rounded up, bandwidths and MTUs down, so decoded routes are never
+ * better than the real ones.
+ *
+ * @param distance_info Distance information to encode, gets sorted.
+ * @param num Number of distance information.
+ * @param out Buffer of at least num * DISTANCE_INFO_WIRE_SIZE bytes.
+ * @return Size of the encoded distance information.
+ */
+size_t encode_distance_info(DISTANCE_INFO *distance_info, int num, char *out)
+{
+#if USE_COMPACT_ROUTING == true
+	uint8_t *p = (uint8_t *) out;
+	CnetAddr last = 0;
+
+	qsort(distance_info, num, sizeof(DISTANCE_INFO), compare_dest_addr);
+	for(int i = 0; i < num; i++) {
+		DISTANCE_INFO *d = &distance_info[i];
+		unsigned delta = d->destAddr - last;
+		last = d->destAddr;
+		do {
+			*p = delta & 0x7f;
+			delta >>= 7;
+			*p++ |= delta ? 0x80 : 0;
+		} while(delta);
+
+		int weight = d->weight < ROUTING_INFINITY ? d->weight : ROUTING_INFINITY;
+		int delay = d->delay < ROUTING_INFINITY ? d->delay : ROUTING_INFINITY;
+		p[0] = compact_code(weight_codes, COMPACT_MAX_CODE + 1, weight, true);
+		p[1] = compact_code(weight_codes, COMPACT_MAX_CODE + 1, delay, true);
+		p[2] = compact_code(bandwidth_codes, COMPACT_MAX_CODE + 1, d->minBWD, false);
+		p[3] = compact_code(mtu_codes, NUM_MTU_CODES, d->minMTU, false);
+		p[4] = compact_code(bandwidth_codes, COMPACT_MAX_CODE + 1, d->fastBWD, false);
+		p[5] = compact_code(mtu_codes, NUM_MTU_CODES, d->fastMTU, false);
+
+		/* the decoded route must not be better than the real one */
+		assert(weight_codes[p[0]] >= weight && weight_codes[p[1]] >= delay);
+		assert(bandwidth_codes[p[2]] <= d->minBWD && mtu_codes[p[3]] <= d->minMTU);
+		assert(bandwidth_codes[p[4]] <= d->fastBWD && mtu_codes[p[5]] <= d->fastMTU);
+		p += 6;
+	}
+	return (char *) p - out;
+#else
+	memcpy(out, distance_info, num * sizeof(DISTANCE_INFO));
+	return num * sizeof(DISTANCE_INFO);
+#endif
+}
+
+
+/**
+ * Decodes the distance information of a routing segment.
+ * Returns the number of distance information or -1 if the data is
+ * malformed or holds more than 'max' of them.
+ *
+ * @param data Encoded distance information.
+ * @param size Size of the encoded distance information.
+ * @param out Decoded distance information.
+ * @param max Size of 'out'.
+ * @return Number of decoded distance information.
+ */
+int decode_distance_info(char *data, size_t size, DISTANCE_INFO *out, int max)
+{
+#if USE_COMPACT_ROUTING == true
+	uint8_t *p = (uint8_t *) data;
+	uint8_t *end = p + size;
+	CnetAddr addr = 0;
+	int num = 0;
+
+	while(p < end) {
+		unsigned delta = 0;
+		int shift = 0;
+		do {
+			if(p == end || shift > 14) {
+				return -1;
 			}
+			delta |= (*p & 0x7f) << shift;
+			shift += 7;
+		} while(*p++ & 0x80);
+
+		if(end - p < 6 || num == max || p[3] >= NUM_MTU_CODES || p[5] >= NUM_MTU_CODES) {
+			return -1;
 		}
+		addr += delta;
+		out[num].destAddr = addr;
+		out[num].weight = weight_codes[p[0]];
+		out[num].delay = weight_codes[p[1]];
+		out[num].minBWD = bandwidth_codes[p[2]];
+		out[num].minMTU = mtu_codes[p[3]];
+		out[num].fastBWD = bandwidth_codes[p[4]];
+		out[num].fastMTU = mtu_codes[p[5]];
+		p += 6;
+		num++;
+	}
+	return num;
+#else
+	int num = size / sizeof(DISTANCE_INFO);
+	if(num > max || size % sizeof(DISTANCE_INFO) != 0) {
+		return -1;
+	}
+	memcpy(out, data, size);
+	return num;
+#endif
+}
 
-		/* broadcast distance updates */
-		if(updates > 0) {
-			broadcast_distance_info(sendDistInfo, updates * sizeof(DISTANCE_INFO));
-		} else {
-			transmit_distance_ack(link);
+
+#if CHECK_COMPACT_ROUTING == true
+/**
+ * Returns whether 'decoded' is the largest code value not above 'value',
+ * found by a linear scan independent of compact_code().
+ */
+bool is_rounded_down(const int *codes, int num, int value, int decoded)
+{
+	if(value == INT_MAX) {
+		return decoded == INT_MAX;
+	}
+	for(int c = 0; c < num; c++) {
+		if(codes[c] > decoded && codes[c] <= value) {
+			return false;
 		}
-	} else if (distInfoLength != 0) { // out of order, no ack
+	}
+	return decoded <= value;
+}
+
+
+/**
+ * Decodes encoded distance information again and asserts that it matches
+ * the original: the same addresses, weights and delays rounded up to the
+ * next code value, ROUTING_INFINITY kept, bandwidths and MTUs rounded down
+ * to the previous one.
+ *
+ * @param distance_info Distance information as encoded, sorted by address.
+ * @param num Number of distance information.
+ * @param data Encoded distance information.
+ * @param size Size of the encoded distance information.
+ */
+void check_distance_info(DISTANCE_INFO *distance_info, int num, char *data, size_t size)
+{
+	DISTANCE_INFO decoded[MAX_NEIGHBOURS];
+	int numDecoded = decode_distance_info(data, size, decoded, MAX_NEIGHBOURS);
+	assert(numDecoded == num);
+
+	for(int i = 0; i < num; i++) {
+		DISTANCE_INFO *in = &distance_info[i], *out = &decoded[i];
+		assert(out->destAddr == in->destAddr);
+#if USE_COMPACT_ROUTING == true
+		assert(out->weight == quantize_weight(in->weight));
+		assert(out->delay == quantize_weight(in->delay));
+		assert(is_rounded_down(bandwidth_codes, COMPACT_MAX_CODE + 1, in->minBWD, out->minBWD));
+		assert(is_rounded_down(mtu_codes, NUM_MTU_CODES, in->minMTU, out->minMTU));
+		assert(is_rounded_down(bandwidth_codes, COMPACT_MAX_CODE + 1, in->fastBWD, out->fastBWD));
+		assert(is_rounded_down(mtu_codes, NUM_MTU_CODES, in->fastMTU, out->fastMTU));
+#else
+		assert(memcmp(out, in, sizeof(DISTANCE_INFO)) == 0);
+#endif
+	}
+}
+#endif
+
+
+/**
+ * Packs distance information and an outgoing link
+ * as a routing segment and delivers it.
+ *
+ * @param distance_info Distance information to send.
+ * @param size Size of distance information.
+ * @param link Link to send the distance information on.
+ */
+void transmit_distance_info(DISTANCE_INFO *distance_info, size_t size, int link)
+{
+	char data[MAX_NEIGHBOURS * DISTANCE_INFO_WIRE_SIZE];
+	size_t dataSize = encode_distance_info(distance_info, size / sizeof(DISTANCE_INFO), data);
+#if CHECK_COMPACT_ROUTING == true
+	check_distance_info(distance_info, size / sizeof(DISTANCE_INFO), data, dataSize);
+#endif
+	transmit_routing_data(data, dataSize, link);
+}
+
+
+/**
+ * Returns how many distance information fit into a routing segment
+ * which is sent as a single frame over the given link.
+ *
+ * @param link Link the routing segment is sent on.
+ * @return Number of distance information per routing segment.
+ */
+int routing_segment_capacity(int link)
+{
+	int space = link_get_mtu(link) - sizeof(marshaled_frame_header)
+							- sizeof(datagram_header) - sizeof(routing_header);
+	int capacity = space / (int) DISTANCE_INFO_WIRE_SIZE;
+
+	capacity = MIN(capacity, MAX_NEIGHBOURS);
+	capacity = MAX(capacity, 1);
+	return capacity;
+}
+
+
+/**
+ * Starts the timer flushing the pending distance updates
+ * and acknowledgments of a neighbour, if there are any.
+ *
+ * @param link Link of the neighbour.
+ */
+void schedule_distance_flush(int link)
+{
+	NEIGHBOUR *nb = &neighbours[link];
+
+	if(nb->flushTimerId == -1 && (nb->numPending > 0 || nb->ackPending)) {
+		nb->flushTimerId = CNET_start_timer(ROUTING_FLUSH_TIMER, ROUTING_COALESCE_TIME, (CnetData) link);
+	}
+}
+
+
+/**
+ * Sends all pending distance updates of a neighbour as one routing segment.
+ * An outstanding acknowledgment is piggybacked. If no updates are pending,
+ * the acknowledgment is sent on its own.
+ *
+ * @param link Link of the neighbour.
+ */
+void flush_distance_info(int link)
+{
+	NEIGHBOUR *nb = &neighbours[link];
+
+	if(nb->flushTimerId != -1) {
+		CNET_stop_timer(nb->flushTimerId);
+		nb->flushTimerId = -1;
+	}
+
+	if(nb->numPending > 0) {
+		transmit_distance_info(nb->pending, nb->numPending * sizeof(DISTANCE_INFO), link);
+		nb->numPending = 0;
+	} else if(nb->ackPending) {
 		transmit_distance_ack(link);
 	}
 }
 
 
 /**
- * Updates the routing table with the given distance information
- * and generates own new routing information to broadcast it to the
- * neighbours if the update led to changes in the forward decision.
- * Returns whether the update led to changes in the forward decision.
- * 
- * @param link Link that received the incoming distance information.
- * @param inDistInfo Incoming distance information.
- * @param outDistInfo Outgoing distance information.
+ * Called when the coalescing time of a neighbour's pending updates expired.
+ *
+ * @param link Link of the neighbour.
  */
-bool update_routing_table(int link, DISTANCE_INFO inDistInfo, DISTANCE_INFO *outDistInfo)
+void distance_flush_timeout(int link)
 {
-	ROUTING_ENTRY *entry = routing_lookup(inDistInfo.destAddr);
-	int bestChoice = 0, bestWeight = INT_MAX;
-	
-	if(NULL == entry) {
-		/* new routing table entry */
-		char key[5];
-		int2string(key, inDistInfo.destAddr);
-		ROUTING_ENTRY newEntry[link_num_links() + 1];
-		for(int i = 0; i <= link_num_links(); i++) {
-			newEntry[i].weight = INT_MAX;
-			newEntry[i].minMTU = INT_MAX;
-			newEntry[i].minBWD = INT_MAX;
-		}
-		hashtable_add(routing_table, key, newEntry, sizeof(newEntry));
-		entry = routing_lookup(inDistInfo.destAddr);
-		bestChoice = link;
+	neighbours[link].flushTimerId = -1;
+	flush_distance_info(link);
+}
+
+
+/**
+ * Adds distance information to the pending updates of a neighbour.
+ * An older pending update for the same destination is replaced.
+ * The updates are flushed as soon as they fill a routing segment.
+ *
+ * @param distInfo Distance information to send.
+ * @param link Link of the neighbour.
+ */
+void queue_distance_info(DISTANCE_INFO *distInfo, int link)
+{
+	NEIGHBOUR *nb = &neighbours[link];
+	int i;
+
+	for(i = 0; i < nb->numPending; i++) {
+		if(nb->pending[i].destAddr == distInfo->destAddr) {
+			break;
+		}
 	}
-	else {
-		for(int i = 1; i <= link_num_links(); i++) {
-			if(entry[i].weight < bestWeight) {
-				bestChoice = i;
-				bestWeight = entry[i].weight;
+	nb->pending[i] = *distInfo;
+
+	if(i == nb->numPending) {
+		nb->numPending++;
+	}
+
+	if(nb->numPending >= routing_segment_capacity(link)) {
+		flush_distance_info(link);
+	} else {
+		schedule_distance_flush(link);
+	}
+}
+
+
+/**
+ * Broadcasts the given distance information to all neigbours.
+ * The updates are coalesced per neighbour before they are sent.
+ * A route is advertised as unreachable to the neighbour it leads over
+ * (poisoned reverse). Unreachable destinations are sent immediately
+ * (triggered update).
+ *
+ * @param distance_info Distance information to send.
+ * @param size Size of distance information.
+ */
+void broadcast_distance_info(DISTANCE_INFO *distance_info, size_t size)
+{
+	int num_neighbours = link_num_links();
+	int num_infos = size / sizeof(DISTANCE_INFO);
+	bool triggered = false;
+
+	for(int i=1; i<=num_neighbours; i++) {
+		if(!neighbours[i].alive) {
+			continue; // gets the whole table when it is back
+		}
+		for(int j=0; j<num_infos; j++) {
+			DISTANCE_INFO distInfo = distance_info[j];
+			if(USE_SPLIT_HORIZON && network_lookup(distInfo.destAddr) == i) {
+				distInfo.weight = ROUTING_INFINITY;
 			}
+			if(USE_SPLIT_HORIZON && network_lookup_class(distInfo.destAddr, CLASS_LATENCY) == i) {
+				distInfo.delay = ROUTING_INFINITY;
+			}
+			triggered |= distance_info[j].weight >= ROUTING_INFINITY;
+			queue_distance_info(&distInfo, i);
 		}
 	}
 
-	assert(NULL != entry);
+	if(triggered) {
+		for(int i=1; i<=num_neighbours; i++) {
+			flush_distance_info(i);
+		}
+	}
+}
 
-	/* update routing table */
-	entry[link].weight = 2 * inDistInfo.weight + get_weight(link);
-	entry[link].minMTU = MIN(inDistInfo.minMTU, link_get_mtu(link));
-	entry[link].minBWD = MIN(inDistInfo.minBWD, link_get_bandwidth(link));
 
-	/* Did the update led to changes in the forward decision? */
-	bool bestChoiceChanged = (bestChoice == link);
-	if(bestChoiceChanged) {
-		outDistInfo->destAddr = inDistInfo.destAddr;
-		outDistInfo->weight = entry[link].weight;
-		outDistInfo->minMTU = entry[link].minMTU;
-		outDistInfo->minBWD = entry[link].minBWD;
+/**
+ * Acknowledges received distance info.
+ *
+ * @param link Link to send the acknowledgment on.
+ */
+void transmit_distance_ack(int link)
+{
+	NEIGHBOUR *nb = &neighbours[link];
 
-		/* update forwarding table */
-		update_forwarding_table(inDistInfo.destAddr, bestChoice);
+	ROUTING_SEGMENT rSeg;
+	rSeg.header.seq_num = 0;
+	rSeg.header.ack_num = nb->nextAckNum;
+	nb->ackPending = false;
+
+	transmit_datagram(link, true, CLASS_LATENCY, 0, (char *)&rSeg, sizeof(routing_header));
+}
+
+
+/**
+ * Receive a routing segment.
+ *
+ * Reads the routing information from the routing segment,
+ * changes the routing table accordingly and potentially broadcasts,
+ * changes in forwarding decisions.
+ * Drops all out of order routing segments (relies on ordered resend).
+ * 
+ * @param link Link which received the routing segment.
+ * @param srcaddr Address of the neighbour which sent the routing segment.
+ * @param data The received routing segment.
+ * @param size Size of the routing segment.
+ */
+void routing_receive(int link, CnetAddr srcaddr, char *data, size_t size)
+{
+	ROUTING_SEGMENT *rSeg = (ROUTING_SEGMENT *)data;
+	NEIGHBOUR *nb = &neighbours[link];
+
+	/* process acknowledgement */
+	int acked = 0;
+	while(nb->outCount > 0) {
+		OUT_ROUTING_SEGMENT *ackSeg = &nb->outRoutingSegments[nb->outFirst];
+		if((int16_t) (rSeg->header.ack_num - ackSeg->rSeg.header.seq_num) <= 0) {
+			break;
+		}
+		nb->outFirst = (nb->outFirst + 1) % nb->outCapacity;
+		nb->outCount--;
+		acked++;
 	}
 
-	/* enable message delivery to that node */
-	CNET_enable_application(inDistInfo.destAddr);
+	/* progress -> reset backoff, stop timer if everything is acknowledged */
+	if(acked > 0) {
+		nb->timeout = ROUTING_TIMEOUT;
+		if(nb->outCount > 0) {
+			restart_routing_timer(link);
+		} else {
+			CNET_stop_timer(nb->timerId);
+			nb->timerId = -1;
+		}
+	}
 
-	/* Logging */
-	printf("Routing table updated on node %d for destination %d\n", nodeinfo.address, inDistInfo.destAddr);
-	for(int i = 1; i <= link_num_links(); i++) {
-		printf("\t(weight %d minBWD: %d)\t", entry[i].weight, entry[i].minBWD);
+#if USE_LINK_STATE == true
+	if(nb->nextAckNum == rSeg->header.seq_num && size > sizeof(routing_header)) { // in order
+		nb->nextAckNum++;
+		nb->ackPending = true;
+		linkstate_receive(link, srcaddr, (char *) rSeg->distance_info, size - sizeof(routing_header));
+		schedule_distance_flush(link);
+	} else {
+		if(size > sizeof(routing_header)) { // out of order, no ack
+			nb->ackPending = true;
+			schedule_distance_flush(link);
+		}
+		linkstate_receive(link, srcaddr, NULL, 0);
+	}
+	return;
+#endif
+
+	DISTANCE_INFO inDistInfo[MAX_NEIGHBOURS];
+	int distInfoLength = decode_distance_info((char *) rSeg->distance_info, size - sizeof(routing_header),
+																						inDistInfo, MAX_NEIGHBOURS);
+	if(distInfoLength < 0) {
+		return; // malformed, the sender resends it
 	}
-	puts("");
 
-	return bestChoiceChanged;
+	if(nb->nextAckNum == rSeg->header.seq_num && distInfoLength != 0) { // in order
+		/* process routing information */
+		int updates = 0;
+		DISTANCE_INFO sendDistInfo[distInfoLength];
+		nb->nextAckNum++;
+
+		for(int i=0; i<distInfoLength; i++) {
+			DISTANCE_INFO distInfo = inDistInfo[i];
+			if(distInfo.destAddr != nodeinfo.address
+				&& update_routing_table(link, distInfo, &(sendDistInfo[updates]))) {
+				updates++;
+			}
+		}
+
+		/* broadcast distance updates, the ack is piggybacked if possible */
+		nb->ackPending = true;
+		if(updates > 0) {
+			broadcast_distance_info(sendDistInfo, updates * sizeof(DISTANCE_INFO));
+		}
+		schedule_distance_flush(link);
+	} else if (distInfoLength != 0) { // out of order, no ack
+		nb->ackPending = true;
+		schedule_distance_flush(link);
+	}
 }
 
 
 /**
- * Updates an entry in the forwarding table.
- * 
- * @param destAddr destination address (key of entry to get changed).
- * @param nextHop next hop in path to destination.
+ * Records that a datagram was sent to a neighbour.
+ * Hellos are only needed on links without other traffic.
+ *
+ * @param link Link of the neighbour.
  */
-void update_forwarding_table(CnetAddr destAddr, int nextHop)
+void neighbour_sent(int link)
 {
-	char key[5];
-	int2string(key, destAddr);
-	hashtable_remove(forwarding_table, key, NULL);
-	hashtable_add(forwarding_table, key, &nextHop, sizeof(nextHop));
+	neighbours[link].lastSent = nodeinfo.time_in_usec;
 }
 
 
 /**
- * Looks up an address in the routing table.
- * 
- * @param addr Address to look up.
+ * Sends the whole distance vector to a neighbour which came back.
+ * Its routes are unknown until it does the same.
+ *
+ * @param link Link of the neighbour.
  */
-ROUTING_ENTRY *routing_lookup(CnetAddr addr)
+void neighbour_up(int link)
 {
-	char key[5];
-	int2string(key, addr);
-	return (ROUTING_ENTRY *) hashtable_find(routing_table, key, NULL);
+	neighbours[link].alive = true;
+
+#if USE_LINK_STATE == true
+	return; // the next routing segment rediscovers the neighbour
+#endif
+
+	DISTANCE_INFO distInfo;
+	distInfo.destAddr = network_get_address();
+	distInfo.weight = 0;
+	distInfo.minMTU = INT_MAX;
+	distInfo.minBWD = INT_MAX;
+	distInfo.delay = 0;
+	distInfo.fastMTU = INT_MAX;
+	distInfo.fastBWD = INT_MAX;
+	queue_distance_info(&distInfo, link);
+
+	for(int i = 0; i < vector_nitems(destinations); i++) {
+		distInfo.destAddr = *(CnetAddr *) vector_peek(destinations, i, NULL);
+		if(network_lookup(distInfo.destAddr) > 0) {
+			ROUTING_ENTRY route = current_route(distInfo.destAddr, routing_lookup(distInfo.destAddr));
+			distInfo.weight = route.weight;
+			distInfo.minMTU = route.minMTU;
+			distInfo.minBWD = route.minBWD;
+			distInfo.delay = route.delay;
+			distInfo.fastMTU = route.fastMTU;
+			distInfo.fastBWD = route.fastBWD;
+			queue_distance_info(&distInfo, link);
+		}
+	}
 }
 
 
 /**
- * Calculates costs for transmitting data over given link.
+ * Records that a datagram was received from a neighbour.
  *
- * @param link Link.
+ * @param link Link of the neighbour.
  */
-int get_weight(int link)
+void neighbour_heard(int link)
 {
-	return 10000000. / link_get_bandwidth(link);
+	neighbours[link].lastHeard = nodeinfo.time_in_usec;
+	if(!neighbours[link].alive) {
+		neighbour_up(link);
+	}
 }
 
 
 /**
- * Initializes the routing algorithm.
+ * Removes all routes over a dead neighbour. Destinations routed over it
+ * immediately switch to the next best link in the routing table, without
+ * hold-down, and the changes are broadcasted (unreachable destinations
+ * as triggered updates).
  *
- * Must be called before the routing algorithm can be used after reboot.
+ * @param link Link of the neighbour.
  */
-void routing_init()
+void neighbour_down(int link)
 {
-	routing_table = hashtable_new(0);
+	neighbours[link].alive = false;
+
+#if USE_LINK_STATE == true
+	linkstate_neighbour_down(link);
+	return;
+#endif
+
+	DISTANCE_INFO distInfo[vector_nitems(destinations) + 1];
+	int updates = 0;
+
+	for(int i = 0; i < vector_nitems(destinations); i++) {
+		CnetAddr destAddr = *(CnetAddr *) vector_peek(destinations, i, NULL);
+		ROUTING_ENTRY *entry = routing_lookup(destAddr);
+		int oldChoice = network_lookup(destAddr);
+		ROUTING_ENTRY oldBest = current_route(destAddr, entry);
+
+		entry[link].weight = ROUTING_INFINITY;
+		entry[link].delay = ROUTING_INFINITY;
+		if(oldChoice != link && network_lookup_class(destAddr, CLASS_LATENCY) != link) {
+			continue;
+		}
 
-	/* initialize data structures */
-	int num_neighbours = link_num_links();
-	neighbours = malloc(sizeof(*neighbours) * (num_neighbours + 1));
+		if(oldChoice == link) {
+			addrmap_remove(hold_down_table, destAddr);
+		}
+		if(select_route(destAddr, entry, oldChoice, oldBest, &distInfo[updates])) {
+			updates++;
+		}
+	}
 
-	for(int i=0; i<=num_neighbours; i++) {
-		neighbours[i].nextSeqNum = 0;
-		neighbours[i].nextAckNum = 0;
-		neighbours[i].outRoutingSegments = vector_new();
+	if(updates > 0) {
+		broadcast_distance_info(distInfo, updates * sizeof(DISTANCE_INFO));
 	}
+}
 
-	/* distribute initial distance information */
-	DISTANCE_INFO distInfo[1];
-	distInfo[0].weight = 0;
-	distInfo[0].minMTU = INT_MAX;
-	distInfo[0].minBWD = INT_MAX;
-	distInfo[0].destAddr = network_get_address();
-	
 
-	broadcast_distance_info(distInfo, sizeof(distInfo));
+/**
+ * Sends hellos on links which were idle for HELLO_INTERVAL and detects
+ * neighbours which were silent for DEAD_INTERVAL.
+ * A hello is a routing segment with just an acknowledgment.
+ * Called every HELLO_INTERVAL.
+ */
+void hello_timeout()
+{
+	CnetTime now = nodeinfo.time_in_usec;
+
+	for(int i = 1; i <= link_num_links(); i++) {
+		NEIGHBOUR *nb = &neighbours[i];
+		if(now - nb->lastSent >= HELLO_INTERVAL) {
+			transmit_distance_ack(i);
+		}
+		if(nb->alive && now - nb->lastHeard > DEAD_INTERVAL) {
+			neighbour_down(i);
+		}
+	}
+
+	CNET_start_timer(HELLO_TIMER, HELLO_INTERVAL, 0);
+}
+
+
+/**
+ * Returns the weight of a route over the given link,
+ * if the neighbour announced weight 'weight' for it.
+ *
+ * @param weight Weight announced by the neighbour.
+ * @param link Link to the neighbour.
+ * @return Weight of the route, at most ROUTING_INFINITY.
+ */
+int route_weight(int weight, int link)
+{
+	if(weight >= ROUTING_INFINITY) {
+		return ROUTING_INFINITY;
+	}
+
+	long long routeWeight = 2LL * weight + get_weight(link);
+	return routeWeight < ROUTING_INFINITY ? routeWeight : ROUTING_INFINITY;
+}
+
+
+/**
+ * Returns the delay of a route over the given link,
+ * if the neighbour announced delay 'delay' for it.
+ *
+ * @param delay Delay announced by the neighbour.
+ * @param link Link to the neighbour.
+ * @return Delay of the route, at most ROUTING_INFINITY.
+ */
+int route_delay(int delay, int link)
+{
+	if(delay >= ROUTING_INFINITY) {
+		return ROUTING_INFINITY;
+	}
+
+	long long routeDelay = delay + link_get_delay(link);
+	return routeDelay < ROUTING_INFINITY ? routeDelay : ROUTING_INFINITY;
+}
+
+
+/**
+ * Returns the link with the smallest weight to a destination or 0 if the
+ * destination is unreachable. While the destination is held down, links
+ * other than the one of the lost route must offer a better route than the
+ * lost one.
+ *
+ * @param destAddr Destination address.
+ * @param entry Routing table entry of the destination.
+ * @return Best link to the destination or 0 if there is none.
+ */
+int best_route(CnetAddr destAddr, ROUTING_ENTRY *entry)
+{
+	HOLD_DOWN *holdDown = addrmap_find(hold_down_table, destAddr);
+	int bestChoice = 0, bestWeight = ROUTING_INFINITY;
+
+	for(int i = 1; i <= link_num_links(); i++) {
+		if(NULL != holdDown && i != holdDown->link && entry[i].weight >= holdDown->weight) {
+			continue;
+		}
+		if(entry[i].weight < bestWeight) {
+			bestChoice = i;
+			bestWeight = entry[i].weight;
+		}
+	}
+
+	return bestChoice;
+}
+
+
+/**
+ * Returns the link with the smallest delay to a destination or 0 if the
+ * destination is unreachable. Only links with a finite weight are used, so
+ * routes to unreachable destinations vanish as fast as the weights
+ * count to infinity.
+ *
+ * @param entry Routing table entry of the destination.
+ * @return Link of the fastest route.
+ */
+int fastest_route(ROUTING_ENTRY *entry)
+{
+	int bestChoice = 0, bestDelay = ROUTING_INFINITY;
+
+	for(int i = 1; i <= link_num_links(); i++) {
+		if(entry[i].weight < ROUTING_INFINITY && entry[i].delay < bestDelay) {
+			bestChoice = i;
+			bestDelay = entry[i].delay;
+		}
+	}
+
+	return bestChoice;
+}
+
+
+/**
+ * Returns the route currently used for a destination: weight, MTU and
+ * bandwidth of the bulk route and delay, MTU and bandwidth of the
+ * fastest route.
+ *
+ * @param destAddr Destination address.
+ * @param entry Routing table entry of the destination.
+ * @return The current route, infinite if there is none.
+ */
+ROUTING_ENTRY current_route(CnetAddr destAddr, ROUTING_ENTRY *entry)
+{
+	int choice = network_lookup(destAddr);
+	int fastChoice = network_lookup_class(destAddr, CLASS_LATENCY);
+	ROUTING_ENTRY route;
+
+	route.weight = choice > 0 ? entry[choice].weight : ROUTING_INFINITY;
+	route.minMTU = choice > 0 ? entry[choice].minMTU : INT_MAX;
+	route.minBWD = choice > 0 ? entry[choice].minBWD : INT_MAX;
+	route.delay = fastChoice > 0 ? entry[fastChoice].delay : ROUTING_INFINITY;
+	route.fastMTU = fastChoice > 0 ? entry[fastChoice].fastMTU : INT_MAX;
+	route.fastBWD = fastChoice > 0 ? entry[fastChoice].fastBWD : INT_MAX;
+	return route;
+}
+
+
+/**
+ * Selects the best route to a destination and updates the forwarding table.
+ * Returns whether the forward decision or the distance to the destination
+ * changed. In this case the new distance information is stored in
+ * 'outDistInfo'.
+ *
+ * @param destAddr Destination address.
+ * @param entry Routing table entry of the destination.
+ * @param oldChoice Link used for the destination so far, -1 if none.
+ * @param oldBest Routing information of the route used so far (see current_route()).
+ * @param outDistInfo Outgoing distance information.
+ * @return Whether the route to the destination changed.
+ */
+bool select_route(CnetAddr destAddr, ROUTING_ENTRY *entry, int oldChoice,
+									ROUTING_ENTRY oldBest, DISTANCE_INFO *outDistInfo)
+{
+	int bestChoice = best_route(destAddr, entry);
+	int fastChoice = fastest_route(entry);
+	ROUTING_ENTRY best = entry[bestChoice];
+	ROUTING_ENTRY fastest = entry[fastChoice];
+
+	if(bestChoice == 0) {
+		best.weight = ROUTING_INFINITY;
+		best.minMTU = INT_MAX;
+		best.minBWD = INT_MAX;
+		bestChoice = -1;
+	}
+	if(fastChoice == 0) {
+		fastest.delay = ROUTING_INFINITY;
+		fastest.fastMTU = INT_MAX;
+		fastest.fastBWD = INT_MAX;
+		fastChoice = -1;
+	}
+
+	bool routeChanged = bestChoice != oldChoice || best.weight != oldBest.weight
+											|| best.minMTU != oldBest.minMTU || best.minBWD != oldBest.minBWD
+											|| fastChoice != network_lookup_class(destAddr, CLASS_LATENCY)
+											|| fastest.delay != oldBest.delay
+											|| fastest.fastMTU != oldBest.fastMTU || fastest.fastBWD != oldBest.fastBWD;
+	if(routeChanged) {
+		outDistInfo->destAddr = destAddr;
+		outDistInfo->weight = best.weight;
+		outDistInfo->minMTU = best.minMTU;
+		outDistInfo->minBWD = best.minBWD;
+		outDistInfo->delay = fastest.delay;
+		outDistInfo->fastMTU = fastest.fastMTU;
+		outDistInfo->fastBWD = fastest.fastBWD;
+
+		/* update forwarding table */
+		update_forwarding_table(destAddr, bestChoice, fastChoice);
+	}
+
+	/* only deliver messages to reachable nodes */
+	if(bestChoice > 0) {
+		CNET_enable_application(destAddr);
+	} else {
+		CNET_disable_application(destAddr);
+	}
+
+	return routeChanged;
+}
+
+
+/**
+ * Holds down a destination, whose route over link 'link' got worse.
+ * The hold-down ends after HOLD_DOWN_TIME.
+ *
+ * @param destAddr Destination address.
+ * @param link Link of the lost route.
+ * @param weight Weight of the lost route.
+ */
+void start_hold_down(CnetAddr destAddr, int link, int weight)
+{
+	HOLD_DOWN holdDown;
+	holdDown.weight = weight;
+	holdDown.link = link;
+
+	if(NULL == addrmap_find(hold_down_table, destAddr)) {
+		CNET_start_timer(HOLD_DOWN_TIMER, HOLD_DOWN_TIME, (CnetData) destAddr);
+	}
+	addrmap_add(hold_down_table, destAddr, &holdDown);
+}
+
+
+/**
+ * Ends the hold-down of a destination. Routes ignored during the hold-down
+ * are considered again and changes are broadcasted.
+ *
+ * @param destAddr Destination address.
+ */
+void hold_down_timeout(CnetAddr destAddr)
+{
+	addrmap_remove(hold_down_table, destAddr);
+
+	ROUTING_ENTRY *entry = routing_lookup(destAddr);
+	int oldChoice = network_lookup(destAddr);
+	ROUTING_ENTRY oldBest = current_route(destAddr, entry);
+
+	DISTANCE_INFO distInfo;
+	if(select_route(destAddr, entry, oldChoice, oldBest, &distInfo)) {
+		broadcast_distance_info(&distInfo, sizeof(distInfo));
+	}
+}
+
+
+/**
+ * Updates the routing table with the given distance information
+ * and generates own new routing information to broadcast it to the
+ * neighbours if the update led to changes in the forward decision.
+ * Returns whether the update led to changes in the forward decision.
+ * 
+ * @param link Link that received the incoming distance information.
+ * @param inDistInfo Incoming distance information.
+ * @param outDistInfo Outgoing distance information.
+ */
+bool update_routing_table(int link, DISTANCE_INFO inDistInfo, DISTANCE_INFO *outDistInfo)
+{
+	ROUTING_ENTRY *entry = routing_lookup(inDistInfo.destAddr);
+	
+	if(NULL == entry) {
+		entry = routing_add(inDistInfo.destAddr);
+	}
+
+	assert(NULL != entry);
+
+	int oldChoice = network_lookup(inDistInfo.destAddr);
+	ROUTING_ENTRY oldBest = current_route(inDistInfo.destAddr, entry);
+
+	/* update routing table */
+	entry[link].weight = route_weight(inDistInfo.weight, link);
+	entry[link].delay = route_delay(inDistInfo.delay, link);
+	entry[link].minMTU = MIN(inDistInfo.minMTU, link_get_mtu(link));
+	entry[link].minBWD = MIN(inDistInfo.minBWD, link_get_bandwidth(link));
+	entry[link].fastMTU = MIN(inDistInfo.fastMTU, link_get_mtu(link));
+	entry[link].fastBWD = MIN(inDistInfo.fastBWD, link_get_bandwidth(link));
+
+	/* the route in use got worse -> do not trust other routes for a while */
+	if(USE_HOLD_DOWN && link == oldChoice && entry[link].weight > oldBest.weight) {
+		start_hold_down(inDistInfo.destAddr, link, oldBest.weight);
+	}
+
+	/* Did the update led to changes in the forward decision? */
+	bool bestChoiceChanged = select_route(inDistInfo.destAddr, entry, oldChoice, oldBest, outDistInfo);
+
+	/* Logging */
+	printf("Routing table updated on node %d for destination %d\n", nodeinfo.address, inDistInfo.destAddr);
+	for(int i = 1; i <= link_num_links(); i++) {
+		printf("\t(weight %d minBWD: %d delay: %d)\t", entry[i].weight, entry[i].minBWD, entry[i].delay);
+	}
+	puts("");
+
+	return bestChoiceChanged;
+}
+
+
+/**
+ * Updates an entry in the forwarding table.
+ * A negative next hop removes the entry (destination unreachable).
+ * Without a fastest route latency traffic takes the bulk route.
+ * 
+ * @param destAddr destination address (key of entry to get changed).
+ * @param nextHop next hop in path to destination for bulk traffic.
+ * @param fastHop next hop in path to destination for latency traffic.
+ */
+void update_forwarding_table(CnetAddr destAddr, int nextHop, int fastHop)
+{
+	int oldHop = network_lookup_class(destAddr, CLASS_BULK);
+	int oldFastHop = network_lookup_class(destAddr, CLASS_LATENCY);
+
+	if(nextHop > 0) {
+		FORWARDING_ENTRY entry;
+		entry.link[CLASS_BULK] = nextHop;
+		entry.link[CLASS_LATENCY] = fastHop > 0 ? fastHop : nextHop;
+		addrmap_add(forwarding_table, destAddr, &entry);
+	} else {
+		addrmap_remove(forwarding_table, destAddr);
+	}
+
+	#if ROUTING_STATS == true
+	printf("%lld: [forwarding_update] dest: %d link: %d fast: %d\n", nodeinfo.time_in_usec, destAddr, nextHop, fastHop);
+	#endif
+
+	/* a connection over an unreachable destination is left alone */
+	if(USE_ROUTE_NOTIFY && nextHop > 0 && oldHop > 0
+	   && (nextHop != oldHop || network_lookup_class(destAddr, CLASS_LATENCY) != oldFastHop)) {
+		transport_route_changed(destAddr);
+	}
+}
+
+
+/**
+ * Looks up an address in the routing table.
+ * 
+ * @param addr Address to look up.
+ */
+ROUTING_ENTRY *routing_lookup(CnetAddr addr)
+{
+	return (ROUTING_ENTRY *) addrmap_find(routing_table, addr);
+}
+
+
+/**
+ * Adds a routing table entry for an address.
+ * All links are initialized as unreachable.
+ *
+ * @param addr Address to add an entry for.
+ * @return The new entry.
+ */
+ROUTING_ENTRY *routing_add(CnetAddr addr)
+{
+	ROUTING_ENTRY newEntry[link_num_links() + 1];
+	for(int i = 0; i <= link_num_links(); i++) {
+		newEntry[i].weight = ROUTING_INFINITY;
+		newEntry[i].minMTU = INT_MAX;
+		newEntry[i].minBWD = INT_MAX;
+		newEntry[i].delay = ROUTING_INFINITY;
+		newEntry[i].fastMTU = INT_MAX;
+		newEntry[i].fastBWD = INT_MAX;
+	}
+	vector_append(destinations, &addr, sizeof(addr));
+	return addrmap_add(routing_table, addr, newEntry);
+}
+
+
+/**
+ * Calculates costs for transmitting data over given link.
+ *
+ * @param link Link.
+ */
+int get_weight(int link)
+{
+	if(link_weights[link] >= 0) {
+		return link_weights[link];
+	}
+	return 10000000. / link_get_bandwidth(link);
+}
+
+
+/**
+ * Loads the weights of the own links from a weight file.
+ * Weights below 1 are ignored, they would let routes loop at no cost.
+ * Returns false if the file cannot be read.
+ *
+ * @param name Name of the weight file.
+ */
+bool weights_load(const char *name)
+{
+	FILE *file = fopen(name, "r");
+	if(NULL == file) {
+		return false;
+	}
+
+	char line[128];
+	while(fgets(line, sizeof(line), file) != NULL) {
+		int addr, link, weight;
+		if(line[0] != '#' && sscanf(line, "%d %d %d", &addr, &link, &weight) == 3
+		   && addr == network_get_address() && link >= 1 && link <= link_num_links() && weight >= 1) {
+			link_weights[link] = weight;
+		}
+	}
+
+	fclose(file);
+	return true;
+}
+
+
+/**
+ * Reads a little endian number of 'bytes' bytes from the route file.
+ * Returns -1 at the end of the file.
+ *
+ * @param file  Route file.
+ * @param bytes Size of the number.
+ */
+long read_route_int(FILE *file, int bytes)
+{
+	long value = 0;
+	for(int i = 0; i < bytes; i++) {
+		int c = fgetc(file);
+		if(c == EOF) {
+			return -1;
+		}
+		value |= (long) c << (8 * i);
+	}
+	return value;
+}
+
+
+/**
+ * Fills the routing table with the routes precomputed for this node.
+ * The file is only used if its links match the links of this node,
+ * otherwise the routing table is left empty.
+ * Returns whether the routes were loaded.
+ *
+ * @param name Name of the route file.
+ */
+bool routing_load(const char *name)
+{
+	FILE *file = fopen(name, "rb");
+	if(NULL == file) {
+		return false;
+	}
+
+	char magic[4];
+	if(fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, "SNRT", 4) != 0
+	   || read_route_int(file, 2) != ROUTE_FILE_VERSION) {
+		fclose(file);
+		return false;
+	}
+
+	/* find the own routes in the index */
+	long numNodes = read_route_int(file, 2);
+	long offset = -1;
+	for(long n = 0; n < numNodes; n++) {
+		long addr = read_route_int(file, 2);
+		long nodeOffset = read_route_int(file, 4);
+		if(addr == network_get_address()) {
+			offset = nodeOffset;
+		}
+	}
+	if(offset < 0 || fseek(file, offset, SEEK_SET) != 0) {
+		fclose(file);
+		return false;
+	}
+
+	long numLinks = read_route_int(file, 1);
+	bool matches = numLinks == link_num_links();
+	for(int i = 1; i <= numLinks; i++) {
+		long bandwidth = read_route_int(file, 4);
+		long mtu = read_route_int(file, 2);
+		long weight = read_route_int(file, 4);
+		matches = matches && bandwidth == link_get_bandwidth(i) && mtu == link_get_mtu(i)
+							&& weight == get_weight(i);
+	}
+	if(!matches) {
+		fclose(file);
+		return false;
+	}
+
+	long numDests = read_route_int(file, 2);
+	for(long d = 0; d < numDests; d++) {
+		CnetAddr destAddr = read_route_int(file, 2);
+		long count = read_route_int(file, 1);
+		ROUTING_ENTRY *entry = routing_add(destAddr);
+		for(long i = 0; i < count; i++) {
+			long link = read_route_int(file, 1);
+			int weight = read_route_int(file, 4);
+			int delay = read_route_int(file, 4);
+			int minMTU = read_route_int(file, 2);
+			int minBWD = read_route_int(file, 4);
+			int fastMTU = read_route_int(file, 2);
+			int fastBWD = read_route_int(file, 4);
+			if(link >= 1 && link <= link_num_links()) {
+				entry[link].weight = weight;
+				entry[link].delay = delay;
+				entry[link].minMTU = minMTU;
+				entry[link].minBWD = minBWD;
+				entry[link].fastMTU = fastMTU;
+				entry[link].fastBWD = fastBWD;
+			}
+		}
+
+		DISTANCE_INFO distInfo;
+		select_route(destAddr, entry, -1, current_route(destAddr, entry), &distInfo);
+	}
+
+	fclose(file);
+	return true;
+}
+
+
+/**
+ * Initializes the routing algorithm.
+ *
+ * Must be called before the routing algorithm can be used after reboot.
+ */
+void routing_init()
+{
+	compact_init();
+	routing_table = addrmap_new((link_num_links() + 1) * sizeof(ROUTING_ENTRY));
+	hold_down_table = addrmap_new(sizeof(HOLD_DOWN));
+
+	/* initialize data structures */
+	int num_neighbours = link_num_links();
+	neighbours = malloc(sizeof(*neighbours) * (num_neighbours + 1));
+
+	for(int i=0; i<=num_neighbours; i++) {
+		neighbours[i].nextSeqNum = 0;
+		neighbours[i].nextAckNum = 0;
+		neighbours[i].outRoutingSegments = malloc(ROUTING_RING_SIZE * sizeof(OUT_ROUTING_SEGMENT));
+		neighbours[i].outCapacity = ROUTING_RING_SIZE;
+		neighbours[i].outFirst = 0;
+		neighbours[i].outCount = 0;
+		neighbours[i].timerId = -1;
+		neighbours[i].timeout = ROUTING_TIMEOUT;
+		neighbours[i].numPending = 0;
+		neighbours[i].ackPending = false;
+		neighbours[i].flushTimerId = -1;
+		neighbours[i].alive = true;
+		neighbours[i].lastHeard = nodeinfo.time_in_usec;
+		neighbours[i].lastSent = 0;
+	}
+	destinations = vector_new();
+
+	link_weights = malloc(sizeof(int) * (num_neighbours + 1));
+	for(int i=0; i<=num_neighbours; i++) {
+		link_weights[i] = -1;
+	}
+	if(USE_WEIGHT_FILE) {
+		weights_load(WEIGHT_FILE);
+	}
+
+	if(USE_HELLO) {
+		CNET_start_timer(HELLO_TIMER, HELLO_INTERVAL, 0);
+	}
+
+#if USE_LINK_STATE == true
+	linkstate_init();
+#else
+	/* neighbours start with the same routes, nothing to distribute */
+	if(USE_ROUTE_FILE && routing_load(ROUTE_FILE)) {
+		return;
+	}
+
+	/* distribute initial distance information */
+	DISTANCE_INFO distInfo[1];
+	distInfo[0].weight = 0;
+	distInfo[0].minMTU = INT_MAX;
+	distInfo[0].minBWD = INT_MAX;
+	distInfo[0].delay = 0;
+	distInfo[0].fastMTU = INT_MAX;
+	distInfo[0].fastBWD = INT_MAX;
+	distInfo[0].destAddr = network_get_address();
+	
+
+	broadcast_distance_info(distInfo, sizeof(distInfo));
+#endif
+}
+
+
+/**********************************************************/
+/*					Link-state routing					*/
+/**********************************************************/
+
+/**
+ * Time in usec link state advertisements are collected
+ * before the shortest paths are recomputed.
+ */
+#define SPF_DELAY 1000
+
+/**
+ * A node of the link state database.
+ */
+typedef struct
+{
+	CnetAddr addr;              // Address of the node.
+	bool known;                 // Whether an LSA of the node was installed.
+	LSA lsa;                    // Last installed LSA of the node.
+	int edges[MAX_LSA_LINKS];   // Database index of the neighbour of each link in lsa.
+	int dist;                   // Weight of the shortest path to the node.
+	int parent;                 // Predecessor on the shortest path, -1 if none.
+	int firstHop;               // Link of this node the shortest path starts with.
+	int minMTU;                 // Minimal MTU on the shortest path.
+	int minBWD;                 // Minimal bandwidth on the shortest path.
+	bool touched;               // Invalidated or changed since the last SPF run.
+} LS_NODE;
+
+
+/**
+ * The link state database. Each node stores its adjacencies as indices
+ * into this array.
+ */
+LS_NODE *lsdb;
+
+/**
+ * Number of nodes in the link state database.
+ */
+int lsdb_nitems;
+
+/**
+ * Number of nodes the link state database can hold.
+ */
+int lsdb_capacity;
+
+/**
+ * Maps addresses to their index in the link state database.
+ *
+ * address -> index
+ */
+ADDRMAP lsdb_index;
+
+/**
+ * Address of the neighbour on each link, -1 if not known yet.
+ */
+int *neighbour_addr;
+
+/**
+ * Sequence number of the last LSA of this node.
+ */
+uint16_t own_seq_num;
+
+/**
+ * Whether a recomputation of the shortest paths is pending.
+ */
+bool spf_scheduled;
+
+
+/**
+ * Returns the database index of an address.
+ * A new node is added to the database if the address is unknown.
+ * Pointers into the database are invalid afterwards.
+ *
+ * @param addr Address to look up.
+ * @return Index of the address in the link state database.
+ */
+int lsdb_lookup(CnetAddr addr)
+{
+	int *index = addrmap_find(lsdb_index, addr);
+
+	if(NULL != index) {
+		return *index;
+	}
+
+	if(lsdb_nitems == lsdb_capacity) {
+		lsdb_capacity *= 2;
+		lsdb = realloc(lsdb, lsdb_capacity * sizeof(*lsdb));
+	}
+
+	int i = lsdb_nitems++;
+	lsdb[i].addr = addr;
+	lsdb[i].known = false;
+	lsdb[i].lsa.num_links = 0;
+	lsdb[i].dist = addr == nodeinfo.address ? 0 : ROUTING_INFINITY;
+	lsdb[i].parent = -1;
+	lsdb[i].firstHop = -1;
+	lsdb[i].minMTU = INT_MAX;
+	lsdb[i].minBWD = INT_MAX;
+	lsdb[i].touched = true;
+	addrmap_add(lsdb_index, addr, &i);
+
+	return i;
+}
+
+
+/**
+ * Calculates costs for transmitting data over the link of a link state:
+ * the weight its node advertised, which get_weight() returned there.
+ *
+ * @param ls Link state.
+ */
+int lsa_weight(LINK_STATE *ls)
+{
+	return MAX(ls->weight, 1);
+}
+
+
+/**
+ * Returns the size of an LSA.
+ *
+ * @param lsa The LSA.
+ */
+size_t lsa_size(LSA *lsa)
+{
+	return offsetof(LSA, links) + lsa->num_links * sizeof(LINK_STATE);
+}
+
+
+/**
+ * Returns whether sequence number 'a' is newer than 'b'.
+ * Sequence numbers wrap around.
+ *
+ * @param a Sequence number to test.
+ * @param b Sequence number to compare with.
+ */
+bool lsa_newer(uint16_t a, uint16_t b)
+{
+	return (int16_t) (a - b) > 0;
+}
+
+
+/**
+ * Returns the weight of the link of node 'v' to node 'u',
+ * or -1 if 'v' does not report such a link.
+ *
+ * @param v Database index of the node describing the link.
+ * @param u Database index of the node at the other end.
+ */
+int lsa_link_weight(int v, int u)
+{
+	for(int i = 0; i < lsdb[v].lsa.num_links; i++) {
+		if(lsdb[v].edges[i] == u) {
+			return lsa_weight(&lsdb[v].lsa.links[i]);
+		}
+	}
+	return -1;
+}
+
+
+/**
+ * Returns the link state of node 'u' for the link to address 'addr',
+ * or NULL if there is none.
+ *
+ * @param lsa LSA of the node.
+ * @param addr Address of the neighbour.
+ */
+LINK_STATE *lsa_find_link(LSA *lsa, CnetAddr addr)
+{
+	for(int i = 0; i < lsa->num_links; i++) {
+		if(lsa->links[i].neighbour == addr) {
+			return &lsa->links[i];
+		}
+	}
+	return NULL;
+}
+
+
+/**
+ * Sends an LSA to all neighbours except the one on link 'exceptLink'.
+ *
+ * @param lsa LSA to flood.
+ * @param exceptLink Link the LSA is not sent on, 0 for none.
+ */
+void flood_lsa(LSA *lsa, int exceptLink)
+{
+	for(int i = 1; i <= link_num_links(); i++) {
+		if(i != exceptLink) {
+			transmit_routing_data((char *) lsa, lsa_size(lsa), i);
+		}
+	}
+}
+
+
+/**
+ * Schedules the recomputation of the shortest paths.
+ */
+void schedule_spf()
+{
+	if(!spf_scheduled) {
+		spf_scheduled = true;
+		CNET_start_timer(SPF_TIMER, SPF_DELAY, 0);
+	}
+}
+
+
+/**
+ * Invalidates the shortest paths to node 'root' and to all nodes whose
+ * shortest path leads over it. They are searched again by the next SPF run.
+ *
+ * @param root Database index of the root of the subtree.
+ */
+void invalidate_subtree(int root)
+{
+	int stack[lsdb_nitems];
+	int num = 0;
+
+	/* every node has one parent, so it is pushed at most once */
+	stack[num++] = root;
+	while(num > 0) {
+		int x = stack[--num];
+		for(int i = 0; i < lsdb[x].lsa.num_links; i++) {
+			if(lsdb[lsdb[x].edges[i]].parent == x) {
+				stack[num++] = lsdb[x].edges[i];
+			}
+		}
+		lsdb[x].dist = ROUTING_INFINITY;
+		lsdb[x].parent = -1;
+		lsdb[x].firstHop = -1;
+		lsdb[x].minMTU = INT_MAX;
+		lsdb[x].minBWD = INT_MAX;
+		lsdb[x].touched = true;
+	}
+}
+
+
+/**
+ * Prepares the incremental recomputation of the shortest paths before
+ * 'lsa' is installed for node 'u'. If a link of the shortest path tree
+ * changes or disappears, the subtree below it is invalidated. The ends of
+ * new or changed links which offer shorter paths are marked, the next
+ * SPF run continues the search from them. Other links cannot change any
+ * shortest path.
+ *
+ * @param u Database index of the node.
+ * @param lsa The new LSA of the node.
+ * @return Whether the shortest paths need to be recomputed.
+ */
+bool invalidate_changed_paths(int u, LSA *lsa)
+{
+	bool affected = false;
+
+	/* changed or removed links of the shortest path tree */
+	for(int i = 0; i < lsdb[u].lsa.num_links; i++) {
+		LINK_STATE *old = &lsdb[u].lsa.links[i];
+		LINK_STATE *new = lsa_find_link(lsa, old->neighbour);
+		int v = lsdb[u].edges[i];
+
+		if(NULL == new || new->bandwidth != old->bandwidth || new->mtu != old->mtu
+		   || new->weight != old->weight) {
+			if(lsdb[v].parent == u) {
+				invalidate_subtree(v);
+				affected = true;
+			} else if(lsdb[u].parent == v) {
+				invalidate_subtree(u);
+				affected = true;
+			}
+		}
+	}
+
+	/* new or changed links which offer shorter paths */
+	for(int i = 0; i < lsa->num_links; i++) {
+		LINK_STATE *new = &lsa->links[i];
+		LINK_STATE *old = lsa_find_link(&lsdb[u].lsa, new->neighbour);
+		if(NULL != old && new->bandwidth == old->bandwidth && new->mtu == old->mtu
+		   && new->weight == old->weight) {
+			continue;
+		}
+
+		int v = lsdb_lookup(new->neighbour);
+		int reverse = lsa_link_weight(v, u);
+		if(reverse < 0) {
+			continue; // link is not used before both ends report it
+		}
+		if(lsdb[u].dist + lsa_weight(new) < lsdb[v].dist ||
+			 lsdb[v].dist + reverse < lsdb[u].dist) {
+			lsdb[u].touched = true;
+			lsdb[v].touched = true;
+			affected = true;
+		}
+	}
+
+	return affected;
+}
+
+
+/**
+ * Stores an LSA in the link state database and schedules the
+ * recomputation of the shortest paths if necessary.
+ *
+ * @param lsa LSA to install.
+ */
+void install_lsa(LSA *lsa)
+{
+	/* make sure all neighbours are in the database */
+	for(int i = 0; i < lsa->num_links; i++) {
+		lsdb_lookup(lsa->links[i].neighbour);
+	}
+	int u = lsdb_lookup(lsa->origin);
+
+	if(invalidate_changed_paths(u, lsa)) {
+		schedule_spf();
+	}
+
+	memcpy(&lsdb[u].lsa, lsa, lsa_size(lsa));
+	lsdb[u].known = true;
+	for(int i = 0; i < lsa->num_links; i++) {
+		lsdb[u].edges[i] = lsdb_lookup(lsa->links[i].neighbour);
+	}
+}
+
+
+/**
+ * Creates a new LSA describing the links of this node to all known
+ * neighbours, installs it and floods it to all neighbours.
+ */
+void originate_lsa()
+{
+	LSA lsa;
+	lsa.origin = nodeinfo.address;
+	lsa.seq_num = ++own_seq_num;
+	lsa.num_links = 0;
+
+	for(int i = 1; i <= link_num_links() && lsa.num_links < MAX_LSA_LINKS; i++) {
+		if(neighbour_addr[i] != -1) {
+			LINK_STATE *ls = &lsa.links[lsa.num_links++];
+			ls->neighbour = neighbour_addr[i];
+			ls->bandwidth = link_get_bandwidth(i);
+			ls->mtu = link_get_mtu(i);
+			ls->load = 1000 * link_get_load(i);
+			ls->weight = get_weight(i);
+		}
+	}
+
+	install_lsa(&lsa);
+	flood_lsa(&lsa, 0);
+}
+
+
+/**
+ * Updates the shortest paths to the nodes in the link state database
+ * incrementally (Dijkstra) and updates their routing and forwarding table
+ * entries.
+ *
+ * The paths to the nodes which invalidate_changed_paths() did not touch
+ * are still valid, at most too long. The search starts from the touched
+ * nodes with a valid path and from the valid neighbours of invalidated
+ * nodes, and only follows links which shorten a path.
+ */
+void compute_shortest_paths()
+{
+	spf_scheduled = false;
+	int self = lsdb_lookup(nodeinfo.address);
+	HEAP heap = heap_new(lsdb_nitems);
+
+	for(int i = 0; i < lsdb_nitems; i++) {
+		if(!lsdb[i].touched) {
+			continue;
+		}
+		if(lsdb[i].dist < ROUTING_INFINITY) {
+			heap_push(heap, lsdb[i].dist, i);
+			continue;
+		}
+		for(int j = 0; j < lsdb[i].lsa.num_links; j++) {
+			int w = lsdb[i].edges[j];
+			if(lsdb[w].dist < ROUTING_INFINITY) {
+				heap_push(heap, lsdb[w].dist, w);
+			}
+		}
+	}
+
+	while(heap_nitems(heap) > 0) {
+		int dist;
+		int u = heap_pop(heap, &dist);
+		if(dist > lsdb[u].dist) {
+			continue; // outdated heap entry
+		}
+
+		for(int i = 0; i < lsdb[u].lsa.num_links; i++) {
+			LINK_STATE *ls = &lsdb[u].lsa.links[i];
+			int v = lsdb[u].edges[i];
+			int alt = dist + lsa_weight(ls);
+
+			if(alt >= lsdb[v].dist || lsa_link_weight(v, u) < 0) {
+				continue;
+			}
+
+			lsdb[v].dist = alt;
+			lsdb[v].parent = u;
+			lsdb[v].touched = true;
+			lsdb[v].minMTU = MIN(lsdb[u].minMTU, ls->mtu);
+			lsdb[v].minBWD = MIN(lsdb[u].minBWD, ls->bandwidth);
+			if(u == self) {
+				for(int link = 1; link <= link_num_links(); link++) {
+					if(neighbour_addr[link] == (int) ls->neighbour) {
+						lsdb[v].firstHop = link;
+						break;
+					}
+				}
+			} else {
+				lsdb[v].firstHop = lsdb[u].firstHop;
+			}
+			heap_push(heap, alt, v);
+		}
+	}
+	heap_free(heap);
+
+	/* update routing and forwarding table of the touched nodes */
+	for(int i = 0; i < lsdb_nitems; i++) {
+		if(!lsdb[i].touched) {
+			continue;
+		}
+		lsdb[i].touched = false;
+		if(i == self) {
+			continue;
+		}
+
+		int nextHop = lsdb[i].dist < ROUTING_INFINITY ? lsdb[i].firstHop : -1;
+		ROUTING_ENTRY *entry = routing_lookup(lsdb[i].addr);
+		if(NULL == entry) {
+			entry = routing_add(lsdb[i].addr);
+		}
+		for(int link = 1; link <= link_num_links(); link++) {
+			entry[link].weight = ROUTING_INFINITY;
+			entry[link].minMTU = INT_MAX;
+			entry[link].minBWD = INT_MAX;
+		}
+
+		/* both traffic classes take the shortest path */
+		if(nextHop > 0) {
+			entry[nextHop].weight = lsdb[i].dist;
+			entry[nextHop].minMTU = lsdb[i].minMTU;
+			entry[nextHop].minBWD = lsdb[i].minBWD;
+			entry[nextHop].fastMTU = lsdb[i].minMTU;
+			entry[nextHop].fastBWD = lsdb[i].minBWD;
+			CNET_enable_application(lsdb[i].addr);
+		} else {
+			CNET_disable_application(lsdb[i].addr);
+		}
+
+		if(nextHop != network_lookup(lsdb[i].addr)) {
+			update_forwarding_table(lsdb[i].addr, nextHop, nextHop);
+		}
+	}
+}
+
+
+/**
+ * Called when the collected LSAs should be used to recompute the
+ * shortest paths.
+ */
+void spf_timeout()
+{
+	compute_shortest_paths();
+}
+
+
+/**
+ * Processes routing data received from a neighbour.
+ *
+ * The neighbour's address is learned from every routing segment. A new
+ * neighbour leads to a new own LSA and the neighbour receives the whole
+ * link state database. New LSAs are installed and flooded to all other
+ * neighbours.
+ *
+ * @param link Link which received the data.
+ * @param srcaddr Address of the neighbour.
+ * @param data Received LSA, NULL if the segment carried none.
+ * @param size Size of the received data.
+ */
+void linkstate_receive(int link, CnetAddr srcaddr, char *data, size_t size)
+{
+	if(neighbour_addr[link] != (int) srcaddr) {
+		/* new neighbour -> describe the link and synchronize databases */
+		neighbour_addr[link] = srcaddr;
+		originate_lsa();
+		for(int i = 0; i < lsdb_nitems; i++) {
+			if(lsdb[i].known && lsdb[i].addr != nodeinfo.address) {
+				transmit_routing_data((char *) &lsdb[i].lsa, lsa_size(&lsdb[i].lsa), link);
+			}
+		}
+	}
+
+	LSA *lsa = (LSA *) data;
+	if(NULL == lsa || size < offsetof(LSA, links) || size < lsa_size(lsa)) {
+		return;
+	}
+
+	if(lsa->origin == nodeinfo.address) {
+		/* own LSA from before a reboot -> continue with a newer one */
+		if(lsa_newer(lsa->seq_num, own_seq_num)) {
+			own_seq_num = lsa->seq_num;
+			originate_lsa();
+		}
+		return;
+	}
+
+	int u = lsdb_lookup(lsa->origin);
+	if(!lsdb[u].known || lsa_newer(lsa->seq_num, lsdb[u].lsa.seq_num)) {
+		install_lsa(lsa);
+		flood_lsa(lsa, link);
+	}
+}
+
+
+/**
+ * Removes the link to a dead neighbour from the own LSA.
+ *
+ * @param link Link of the neighbour.
+ */
+void linkstate_neighbour_down(int link)
+{
+	if(neighbour_addr[link] != -1) {
+		neighbour_addr[link] = -1;
+		originate_lsa();
+	}
+}
+
+
+/**
+ * Initializes the link-state routing and announces this node.
+ */
+void linkstate_init()
+{
+	lsdb_nitems = 0;
+	lsdb_capacity = 16;
+	lsdb = malloc(lsdb_capacity * sizeof(*lsdb));
+	lsdb_index = addrmap_new(sizeof(int));
+	own_seq_num = 0;
+	spf_scheduled = false;
+
+	neighbour_addr = malloc((link_num_links() + 1) * sizeof(*neighbour_addr));
+	for(int i = 0; i <= link_num_links(); i++) {
+		neighbour_addr[i] = -1;
+	}
+
+	originate_lsa();
 }
@@ -9,12 +9,17 @@
 #ifndef NETWORK_H_
 #define NETWORK_H_
 
-void network_transmit(CnetAddr, char *, size_t);
+void network_transmit(CnetAddr, int, char *, size_t);
 void network_receive(int, char *, size_t);
+void network_transmit_multicast(CnetAddr, char *, size_t);
+void network_join_group(CnetAddr, CnetAddr);
 void network_init();
 
 int network_lookup(CnetAddr);
+int network_lookup_class(CnetAddr, int);
 CnetAddr network_get_address();
-int network_get_bandwidth(CnetAddr addr);
+int network_get_bandwidth(CnetAddr addr, int tclass);
+int network_get_mtu(CnetAddr addr, int tclass);
+CnetTime network_get_queue_delay(CnetAddr addr, int tclass);
 
 #endif
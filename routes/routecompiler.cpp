@@ -0,0 +1,335 @@
+#include "routecompiler.h"
+
+#include <queue>
+#include <climits>
+
+
+using namespace std;
+
+
+
+
+
+RouteCompiler::RouteCompiler(const string& input, const string& output, const string& weights)
+	: topology(input)
+{
+	if(!weights.empty()) {
+		topology.readWeights(weights);
+	}
+	const vector<host_t>& hosts = topology.getHosts();
+	routes.resize(hosts.size(), vector<entry_t>(hosts.size()));
+	for(size_t dest = 0; dest < hosts.size(); dest++) {
+		computeRoutes(dest);
+	}
+	write(output);
+
+}
+
+/**
+ * Same as route_weight() in network.c: twice the weight advertised by the
+ * neighbour, as the node receives it, plus the weight node 'node' uses for
+ * its link l, cut down to ROUTING_INFINITY.
+ */
+int RouteCompiler::routeWeight(int weight, int node, int l) const
+{
+	weight = quantize_weight(weight);
+	if(weight >= ROUTING_INFINITY) {
+		return ROUTING_INFINITY;
+	}
+	int64_t w = 2LL * weight + topology.weight(node, l);
+	return w < ROUTING_INFINITY ? w : ROUTING_INFINITY;
+}
+
+/**
+ * Same as best_route() in network.c: the first link with the lowest weight.
+ */
+int RouteCompiler::bestRoute(const entry_t& entry) const
+{
+	int bestChoice = 0, bestWeight = ROUTING_INFINITY;
+	for(size_t i = 1; i < entry.size(); i++) {
+		if(entry[i].weight < bestWeight) {
+			bestChoice = i;
+			bestWeight = entry[i].weight;
+		}
+	}
+	return bestChoice;
+}
+
+/**
+ * Computes the entries of all nodes for destination 'dest'.
+ *
+ * The weight a node advertises is the fixpoint of the distance vector
+ * updates, which a Dijkstra search from the destination finds since
+ * route weights only grow along a path. Entries of links over which the
+ * neighbour routes back to the node are poisoned, as with split horizon.
+ */
+void RouteCompiler::computeRoutes(int dest)
+{
+	const vector<host_t>& hosts = topology.getHosts();
+	const vector<link_t>& links = topology.getLinks();
+	int n = hosts.size();
+
+	vector<int> weight(n, ROUTING_INFINITY);
+	vector<int> order;
+	vector<bool> done(n, false);
+	priority_queue<pair<int, int>, vector<pair<int, int> >, greater<pair<int, int> > > queue;
+	weight[dest] = 0;
+	queue.push(make_pair(0, dest));
+
+	while(!queue.empty()) {
+		int node = queue.top().second;
+		queue.pop();
+		if(done[node]) {
+			continue;
+		}
+		done[node] = true;
+		order.push_back(node);
+		for(size_t l = 0; l < hosts[node].links.size(); l++) {
+			int other = topology.neighbour(node, l);
+			int w = routeWeight(weight[node], other, topology.linkIndex(other, hosts[node].links[l]));
+			if(w < weight[other]) {
+				weight[other] = w;
+				queue.push(make_pair(w, other));
+			}
+		}
+	}
+
+	//the best link of each node, and the path minima it advertises
+	vector<int> best(n, 0);
+	route_t unknown = {ROUTING_INFINITY, INT_MAX, INT_MAX, ROUTING_INFINITY, INT_MAX, INT_MAX};
+	vector<route_t> advertised(n, unknown);
+	advertised[dest].weight = 0;
+
+	//nodes come in order of their weight, so the next hop is always known
+	for(size_t i = 0; i < order.size(); i++) {
+		int node = order[i];
+		if(node == dest) {
+			continue;
+		}
+		entry_t entry(hosts[node].links.size() + 1);
+		for(size_t l = 0; l < hosts[node].links.size(); l++) {
+			entry[l + 1].weight = routeWeight(weight[topology.neighbour(node, l)], node, l);
+		}
+		best[node] = bestRoute(entry);
+		const link_t& link = links[hosts[node].links[best[node] - 1]];
+		const route_t& next = advertised[topology.neighbour(node, best[node] - 1)];
+		advertised[node].weight = weight[node];
+		advertised[node].minMTU = min(next.minMTU, link.mtu);
+		advertised[node].minBWD = min(next.minBWD, link.bandwidth);
+	}
+
+	for(size_t i = 0; i < order.size(); i++) {
+		int node = order[i];
+		if(node == dest) {
+			continue;
+		}
+		entry_t& entry = routes[node][dest];
+		entry.resize(hosts[node].links.size() + 1);
+		for(size_t l = 0; l < hosts[node].links.size(); l++) {
+			int other = topology.neighbour(node, l);
+			const link_t& link = links[hosts[node].links[l]];
+			route_t& route = entry[l + 1];
+			bool poisoned = other != dest && best[other] > 0 && topology.neighbour(other, best[other] - 1) == node;
+			route.delay = ROUTING_INFINITY;
+			route.fastMTU = INT_MAX;
+			route.fastBWD = INT_MAX;
+			if(poisoned || !done[other]) {
+				route.weight = ROUTING_INFINITY;
+				route.minMTU = INT_MAX;
+				route.minBWD = INT_MAX;
+			} else {
+				route.weight = routeWeight(advertised[other].weight, node, l);
+				route.minMTU = min(advertised[other].minMTU, link.mtu);
+				route.minBWD = min(advertised[other].minBWD, link.bandwidth);
+			}
+		}
+	}
+
+	computeDelays(dest, best);
+}
+
+/**
+ * Computes the delays of the entries for destination 'dest', like
+ * fastest_route() in network.c: only links with a finite weight are used,
+ * the delay of a link is its propagation delay (queues are empty at boot).
+ * Advertised delays are quantized like weights. Along with the delays
+ * the MTU and bandwidth minima of the fastest routes are computed.
+ * 'best' holds the link of each node's bulk route.
+ */
+void RouteCompiler::computeDelays(int dest, const vector<int>& best)
+{
+	const vector<host_t>& hosts = topology.getHosts();
+	const vector<link_t>& links = topology.getLinks();
+	int n = hosts.size();
+
+	vector<int64_t> delay(n, ROUTING_INFINITY);
+	vector<int> fastest(n, 0);
+	vector<int> fastMTU(n, INT_MAX), fastBWD(n, INT_MAX);
+	vector<bool> done(n, false);
+	priority_queue<pair<int64_t, int>, vector<pair<int64_t, int> >, greater<pair<int64_t, int> > > queue;
+	delay[dest] = 0;
+	queue.push(make_pair(0, dest));
+
+	while(!queue.empty()) {
+		int node = queue.top().second;
+		queue.pop();
+		if(done[node]) {
+			continue;
+		}
+		done[node] = true;
+
+		//the first link with minimal delay, as the nodes choose it
+		if(node != dest) {
+			entry_t& entry = routes[node][dest];
+			int64_t fastestDelay = ROUTING_INFINITY;
+			for(size_t l = 1; l < entry.size(); l++) {
+				int other = topology.neighbour(node, l - 1);
+				int64_t d = quantize_weight(delay[other]) + links[hosts[node].links[l - 1]].propagationDelay;
+				if(done[other] && entry[l].weight < ROUTING_INFINITY && d < fastestDelay) {
+					fastestDelay = d;
+					fastest[node] = l;
+				}
+			}
+			if(fastest[node] > 0) {
+				const link_t& link = links[hosts[node].links[fastest[node] - 1]];
+				int other = topology.neighbour(node, fastest[node] - 1);
+				fastMTU[node] = min(fastMTU[other], link.mtu);
+				fastBWD[node] = min(fastBWD[other], link.bandwidth);
+			}
+		}
+
+		for(size_t l = 0; l < hosts[node].links.size(); l++) {
+			int other = topology.neighbour(node, l);
+			//the other node can only use the link if its weight is finite,
+			//which it is not if this node routes bulk traffic back over it
+			if(other == dest || (node != dest && topology.neighbour(node, best[node] - 1) == other)) {
+				continue;
+			}
+			int64_t d = min<int64_t>(quantize_weight(delay[node]) + links[hosts[node].links[l]].propagationDelay, ROUTING_INFINITY);
+			if(d < delay[other]) {
+				delay[other] = d;
+				queue.push(make_pair(d, other));
+			}
+		}
+	}
+
+	//entries, poisoned if the neighbour's fastest route leads back
+	for(int node = 0; node < n; node++) {
+		entry_t& entry = routes[node][dest];
+		for(size_t l = 1; l < entry.size(); l++) {
+			int other = topology.neighbour(node, l - 1);
+			bool poisoned = other != dest && fastest[other] > 0 && topology.neighbour(other, fastest[other] - 1) == node;
+			if(entry[l].weight < ROUTING_INFINITY && delay[other] < ROUTING_INFINITY && !poisoned) {
+				const link_t& link = links[hosts[node].links[l - 1]];
+				entry[l].delay = min<int64_t>(quantize_weight(delay[other]) + link.propagationDelay, ROUTING_INFINITY);
+				entry[l].fastMTU = min(fastMTU[other], link.mtu);
+				entry[l].fastBWD = min(fastBWD[other], link.bandwidth);
+			}
+		}
+	}
+}
+
+/**
+ * Writes the route file, all numbers little endian:
+ *
+ * "SNRT", version (2), number of nodes (2)
+ * index per node:  address (2), file offset of the node (4)
+ * per node:        number of links (1),
+ *                  per link: bandwidth (4), mtu (2), weight (4),
+ *                  number of destinations (2)
+ * per destination: address (2), number of reachable links (1)
+ * per link:        link (1), weight (4), delay (4), minMTU (2), minBWD (4),
+ *                  fastMTU (2), fastBWD (4)
+ *
+ * Links a destination is unreachable over are left out. The links are
+ * stored to detect a topology or weight mismatch when the file is loaded. The index
+ * lets a node seek to its own routes directly.
+ */
+void RouteCompiler::write(const string& file)
+{
+	const vector<host_t>& hosts = topology.getHosts();
+	const vector<link_t>& links = topology.getLinks();
+	stringstream body;
+	vector<int64_t> offsets;
+
+	int numRoutes = 0;
+	for(size_t node = 0; node < hosts.size(); node++) {
+		offsets.push_back(body.tellp());
+		writeInt(body, hosts[node].links.size(), 1);
+		for(size_t l = 0; l < hosts[node].links.size(); l++) {
+			writeInt(body, links[hosts[node].links[l]].bandwidth, 4);
+			writeInt(body, links[hosts[node].links[l]].mtu, 2);
+			writeInt(body, topology.weight(node, l), 4);
+		}
+
+		int numDests = 0;
+		for(size_t dest = 0; dest < hosts.size(); dest++) {
+			numDests += !routes[node][dest].empty();
+		}
+		writeInt(body, numDests, 2);
+
+		for(size_t dest = 0; dest < hosts.size(); dest++) {
+			const entry_t& entry = routes[node][dest];
+			if(entry.empty()) {
+				continue;
+			}
+			int reachable = 0;
+			for(size_t l = 1; l < entry.size(); l++) {
+				reachable += entry[l].weight < ROUTING_INFINITY;
+			}
+			writeInt(body, hosts[dest].address, 2);
+			writeInt(body, reachable, 1);
+			for(size_t l = 1; l < entry.size(); l++) {
+				if(entry[l].weight >= ROUTING_INFINITY) {
+					continue;
+				}
+				writeInt(body, l, 1);
+				writeInt(body, entry[l].weight, 4);
+				writeInt(body, entry[l].delay, 4);
+				writeInt(body, entry[l].minMTU, 2);
+				writeInt(body, entry[l].minBWD, 4);
+				writeInt(body, entry[l].fastMTU, 2);
+				writeInt(body, entry[l].fastBWD, 4);
+			}
+			numRoutes++;
+		}
+	}
+
+	ofstream fout(file.c_str(), ios::out | ios::binary);
+	fout.write("SNRT", 4);
+	writeInt(fout, ROUTE_FILE_VERSION, 2);
+	writeInt(fout, hosts.size(), 2);
+	int64_t headerSize = 8 + 6 * hosts.size();
+	for(size_t node = 0; node < hosts.size(); node++) {
+		writeInt(fout, hosts[node].address, 2);
+		writeInt(fout, headerSize + offsets[node], 4);
+	}
+	fout << body.rdbuf();
+	fout.close();
+
+	cout << hosts.size() << " nodes, " << links.size() << " links, "
+	     << numRoutes << " routes written to " << file << endl;
+}
+
+void RouteCompiler::writeInt(ostream& out, int64_t value, int bytes)
+{
+	for(int i = 0; i < bytes; i++) {
+		out.put((char) ((value >> (8 * i)) & 0xff));
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	if(argc >= 3) {
+		try {
+			RouteCompiler r(argv[1], argv[2], argc >= 4 ? argv[3] : "");
+		} catch(const exception& e) {
+			cerr << argv[0] << ": " << e.what() << endl;
+			return 1;
+		}
+	} else {
+		std::cout << "usage: " << argv[0] << " <topology> <output> [weights]" << std::endl;
+	}
+	return 0;
+}
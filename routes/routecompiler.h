@@ -0,0 +1,56 @@
+#ifndef ROUTECOMPILER_H
+#define ROUTECOMPILER_H
+
+#include "topology.h"
+#include "../weights.h"
+
+/* must match ROUTE_FILE_VERSION in network.c */
+#define ROUTE_FILE_VERSION 6
+
+
+/* routing table entry of one link, as network.c keeps it */
+struct route_t {
+	int weight;
+	int minMTU;
+	int minBWD;
+	int delay;
+	int fastMTU;
+	int fastBWD;
+};
+
+/* routes of a node to one destination, index 0 is unused like in network.c */
+typedef std::vector<route_t> entry_t;
+
+
+/**
+ * Computes the routing tables the distance vector algorithm of network.c
+ * converges to and writes them to a binary route file.
+ */
+class RouteCompiler
+{
+public:
+	RouteCompiler(const std::string& input, const std::string& output,
+	              const std::string& weights = "");
+	
+	
+private:
+	
+	void computeRoutes(int dest);
+	
+	void computeDelays(int dest, const std::vector<int>& best);
+	
+	int bestRoute(const entry_t& entry) const;
+	
+	int routeWeight(int weight, int node, int l) const;
+	
+	void write(const std::string& file);
+	
+	void writeInt(std::ostream& out, int64_t value, int bytes);
+	
+	Topology topology;
+	
+	//node, destination -> routing table entry
+	std::vector<std::vector<entry_t> > routes;
+};
+
+#endif
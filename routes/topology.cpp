@@ -0,0 +1,446 @@
+#include "topology.h"
+
+#include <cctype>
+#include <cstdlib>
+
+
+using namespace std;
+
+
+
+
+
+Topology::Topology(const string& file)
+	: pos(0)
+{
+	defaultLink.from = -1;
+	defaultLink.to = -1;
+	defaultLink.bandwidth = 56000;
+	defaultLink.mtu = 1500;
+	defaultLink.propagationDelay = 2500000;
+	defaultMessageRate = 1000000;
+
+	string text;
+	preprocess(file, text);
+	tokenize(text);
+	parse();
+}
+
+int Topology::neighbour(int h, int l) const
+{
+	const link_t& link = links[hosts[h].links[l]];
+	return link.from == h ? link.to : link.from;
+}
+
+int Topology::findAddress(int address) const
+{
+	for(size_t i = 0; i < hosts.size(); i++) {
+		if(hosts[i].address == address) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+int Topology::linkIndex(int h, int link) const
+{
+	for(size_t l = 0; l < hosts[h].links.size(); l++) {
+		if(hosts[h].links[l] == link) {
+			return l;
+		}
+	}
+	return -1;
+}
+
+int Topology::defaultWeight(const link_t& link)
+{
+	return (int) (10000000. / link.bandwidth);
+}
+
+/**
+ * Reads a weight file. Each line holds the address of a host, the number
+ * of one of its links as cnet numbers them (starting at 1) and the weight
+ * the host uses for it, at least 1. Lines starting with # are comments.
+ */
+void Topology::readWeights(const string& file)
+{
+	ifstream fin(file.c_str(), ios::in);
+	if(!fin) {
+		throw runtime_error("cannot open " + file);
+	}
+	string st;
+	while(getline(fin, st)) {
+		if(st.empty() || st[0] == '#') {
+			continue;
+		}
+		stringstream h(st);
+		int address, link, weight;
+		if(!(h >> address >> link >> weight)) {
+			throw runtime_error("malformed line in " + file + ": " + st);
+		}
+		if(weight < 1) {
+			throw runtime_error("weight below 1 in " + file + ": " + st);
+		}
+		int host = findAddress(address);
+		if(host < 0 || link < 1 || link > (int) hosts[host].links.size()) {
+			throw runtime_error("unknown link in " + file + ": " + st);
+		}
+		hosts[host].weights[link - 1] = weight;
+	}
+	fin.close();
+}
+
+/**
+ * Writes a weight file (see readWeights()). Only weights which differ from
+ * the bandwidth based ones are written.
+ */
+void Topology::writeWeights(const string& file, const string& comment) const
+{
+	ofstream fout(file.c_str(), ios::out);
+	if(!fout) {
+		throw runtime_error("cannot write " + file);
+	}
+	fout << "# " << comment << endl;
+	fout << "# address link weight" << endl;
+	for(size_t h = 0; h < hosts.size(); h++) {
+		for(size_t l = 0; l < hosts[h].links.size(); l++) {
+			if(hosts[h].weights[l] != defaultWeight(links[hosts[h].links[l]])) {
+				fout << hosts[h].address << " " << l + 1 << " " << hosts[h].weights[l] << endl;
+			}
+		}
+	}
+	fout.close();
+}
+
+/**
+ * Resolves #include and #define directives and strips // comments.
+ * Included files are looked up relative to the including file.
+ */
+void Topology::preprocess(const string& file, string& out)
+{
+	ifstream fin(file.c_str(), ios::in);
+	if(!fin) {
+		throw runtime_error("cannot open " + file);
+	}
+	string dir = "";
+	if(file.find_last_of('/') != string::npos) {
+		dir = file.substr(0, file.find_last_of('/') + 1);
+	}
+
+	string st;
+	while(getline(fin, st)) {
+		//strip comments outside of strings
+		bool quoted = false;
+		for(size_t i = 0; i < st.size(); i++) {
+			if(st[i] == '"') {
+				quoted = !quoted;
+			} else if(!quoted && st.compare(i, 2, "//") == 0) {
+				st = st.substr(0, i);
+				break;
+			}
+		}
+
+		stringstream h(st);
+		string directive;
+		h >> directive;
+		if(directive == "#include") {
+			string name;
+			h >> name;
+			preprocess(dir + name.substr(1, name.size() - 2), out);
+		} else if(directive == "#define") {
+			string head;
+			h >> head;
+			macro_t macro;
+			size_t paren = head.find('(');
+			if(paren != string::npos) {
+				//parameters may contain blanks, read up to the closing bracket
+				string rest;
+				getline(h, rest);
+				head += rest;
+				size_t close = head.find(')');
+				stringstream params(head.substr(paren + 1, close - paren - 1));
+				string param;
+				while(getline(params, param, ',')) {
+					param.erase(0, param.find_first_not_of(" \t"));
+					param.erase(param.find_last_not_of(" \t") + 1);
+					macro.params.push_back(param);
+				}
+				macro.body = head.substr(close + 1);
+				head = head.substr(0, paren);
+			} else {
+				getline(h, macro.body);
+			}
+			macros[head] = macro;
+		} else {
+			out += expand(st) + "\n";
+		}
+	}
+	fin.close();
+}
+
+/**
+ * Expands all macros in a line. Arguments are substituted by name and
+ * ## pastes the surrounding tokens together.
+ */
+string Topology::expand(const string& line)
+{
+	string result;
+	size_t i = 0;
+	while(i < line.size()) {
+		if(!isalpha(line[i]) && line[i] != '_') {
+			result += line[i++];
+			continue;
+		}
+		size_t start = i;
+		while(i < line.size() && (isalnum(line[i]) || line[i] == '_')) {
+			i++;
+		}
+		string word = line.substr(start, i - start);
+		map<string, macro_t>::iterator it = macros.find(word);
+		if(it == macros.end()) {
+			result += word;
+			continue;
+		}
+
+		macro_t& macro = it->second;
+		vector<string> args;
+		if(!macro.params.empty()) {
+			size_t open = line.find('(', i);
+			size_t close = line.find(')', open);
+			if(open == string::npos || close == string::npos) {
+				throw runtime_error("malformed use of macro " + word);
+			}
+			stringstream h(line.substr(open + 1, close - open - 1));
+			string arg;
+			while(getline(h, arg, ',')) {
+				arg.erase(0, arg.find_first_not_of(" \t"));
+				arg.erase(arg.find_last_not_of(" \t") + 1);
+				args.push_back(arg);
+			}
+			i = close + 1;
+		}
+
+		//substitute parameters
+		string body;
+		size_t j = 0;
+		while(j < macro.body.size()) {
+			if(!isalpha(macro.body[j]) && macro.body[j] != '_') {
+				body += macro.body[j++];
+				continue;
+			}
+			size_t s = j;
+			while(j < macro.body.size() && (isalnum(macro.body[j]) || macro.body[j] == '_')) {
+				j++;
+			}
+			string name = macro.body.substr(s, j - s);
+			size_t p;
+			for(p = 0; p < macro.params.size() && macro.params[p] != name; p++);
+			body += p < macro.params.size() && p < args.size() ? args[p] : name;
+		}
+
+		//token pasting
+		size_t paste;
+		while((paste = body.find("##")) != string::npos) {
+			size_t left = body.find_last_not_of(" \t", paste - 1) + 1;
+			size_t right = body.find_first_not_of(" \t", paste + 2);
+			body.erase(left, right - left);
+		}
+		result += body;
+	}
+	return result;
+}
+
+/**
+ * Splits the text into words, numbers, strings and the symbols { } = ,
+ * A number directly followed by a unit ("96bytes") yields two tokens.
+ */
+void Topology::tokenize(const string& text)
+{
+	size_t i = 0;
+	while(i < text.size()) {
+		char c = text[i];
+		if(isspace(c)) {
+			i++;
+		} else if(c == '"') {
+			size_t end = text.find('"', i + 1);
+			tokens.push_back(text.substr(i, end - i + 1));
+			i = end + 1;
+		} else if(isdigit(c) || c == '.') {
+			size_t start = i;
+			while(i < text.size() && (isdigit(text[i]) || text[i] == '.')) {
+				i++;
+			}
+			tokens.push_back(text.substr(start, i - start));
+		} else if(isalpha(c) || c == '_') {
+			size_t start = i;
+			while(i < text.size() && (isalnum(text[i]) || text[i] == '_' || text[i] == '-')) {
+				i++;
+			}
+			tokens.push_back(text.substr(start, i - start));
+		} else {
+			tokens.push_back(string(1, c));
+			i++;
+		}
+	}
+}
+
+void Topology::parse()
+{
+	while(pos < tokens.size()) {
+		if(tokens[pos] == "host" || tokens[pos] == "router") {
+			pos++;
+			parseHost();
+		} else if(pos + 1 < tokens.size() && tokens[pos + 1] == "=") {
+			string name = tokens[pos];
+			pos += 2;
+			parseAttribute(name, NULL, &defaultLink);
+		} else {
+			pos++;
+		}
+	}
+
+	//link attributes are known now
+	for(size_t h = 0; h < hosts.size(); h++) {
+		for(size_t l = 0; l < hosts[h].links.size(); l++) {
+			hosts[h].weights.push_back(defaultWeight(links[hosts[h].links[l]]));
+		}
+	}
+}
+
+void Topology::parseHost()
+{
+	int host = findHost(tokens[pos++]);
+	if(tokens[pos++] != "{") {
+		throw runtime_error("expected { after host " + hosts[host].name);
+	}
+	while(pos < tokens.size() && tokens[pos] != "}") {
+		if(tokens[pos] == "wan" || tokens[pos] == "lan") {
+			pos++;
+			parseLink(host);
+		} else if(pos + 1 < tokens.size() && tokens[pos + 1] == "=") {
+			string name = tokens[pos];
+			pos += 2;
+			parseAttribute(name, &hosts[host], NULL);
+		} else {
+			pos++;
+		}
+	}
+	pos++;
+}
+
+/**
+ * Parses "to OTHER { attributes }". A link is numbered at both ends when
+ * it is first mentioned, which is the order cnet assigns link numbers in.
+ */
+void Topology::parseLink(int host)
+{
+	if(tokens[pos] == "to") {
+		pos++;
+	}
+	int other = findHost(tokens[pos++]);
+
+	int index = -1;
+	for(size_t i = 0; i < hosts[host].links.size(); i++) {
+		if(neighbour(host, i) == other) {
+			index = hosts[host].links[i];
+		}
+	}
+	if(index < 0) {
+		link_t link = defaultLink;
+		link.from = host;
+		link.to = other;
+		index = links.size();
+		links.push_back(link);
+		hosts[host].links.push_back(index);
+		hosts[other].links.push_back(index);
+	}
+
+	if(pos < tokens.size() && tokens[pos] == "{") {
+		pos++;
+		while(pos < tokens.size() && tokens[pos] != "}") {
+			if(pos + 1 < tokens.size() && tokens[pos + 1] == "=") {
+				string name = tokens[pos];
+				pos += 2;
+				parseAttribute(name, NULL, &links[index]);
+			} else {
+				pos++;
+			}
+		}
+		pos++;
+	}
+}
+
+/**
+ * Reads the value of an attribute and stores the ones the tools need.
+ */
+void Topology::parseAttribute(const string& name, host_t* host, link_t* link)
+{
+	string value = tokens[pos++];
+	string unit = "";
+	if(isUnit(pos)) {
+		unit = tokens[pos++];
+	}
+	if(pos < tokens.size() && tokens[pos] == ",") {
+		pos++;
+	}
+
+	double number = atof(value.c_str());
+	if(unit == "Kbps" || unit == "KB") {
+		number *= 1000;
+	} else if(unit == "Mbps" || unit == "MB") {
+		number *= 1000000;
+	} else if(unit == "ms" || unit == "msec" || unit == "msecs") {
+		number *= 1000;
+	} else if(unit == "s" || unit == "sec" || unit == "secs") {
+		number *= 1000000;
+	}
+
+	if(name == "address" && host != NULL) {
+		host->address = (int) number;
+	} else if(name == "messagerate") {
+		if(host != NULL) {
+			host->messageRate = (int64_t) number;
+		} else {
+			defaultMessageRate = (int64_t) number;
+		}
+	} else if(link != NULL) {
+		if(name == "bandwidth") {
+			link->bandwidth = (int) number;
+		} else if(name == "mtu") {
+			link->mtu = (int) number;
+		} else if(name == "propagationdelay") {
+			link->propagationDelay = (int64_t) number;
+		}
+	}
+}
+
+int Topology::findHost(const string& name)
+{
+	for(size_t i = 0; i < hosts.size(); i++) {
+		if(hosts[i].name == name) {
+			return i;
+		}
+	}
+	host_t host;
+	host.name = name;
+	host.address = hosts.size();
+	host.messageRate = defaultMessageRate;
+	hosts.push_back(host);
+	return hosts.size() - 1;
+}
+
+bool Topology::isUnit(size_t p) const
+{
+	static const char* units[] = {"bps", "Kbps", "Mbps", "bytes", "KB", "MB",
+	                              "usec", "usecs", "ms", "msec", "msecs",
+	                              "s", "sec", "secs", "m", "km", NULL};
+	if(p >= tokens.size()) {
+		return false;
+	}
+	for(int i = 0; units[i] != NULL; i++) {
+		if(tokens[p] == units[i]) {
+			return true;
+		}
+	}
+	return false;
+}
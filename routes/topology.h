@@ -0,0 +1,106 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <stdexcept>
+#include <sys/types.h>
+
+
+/* a link between two hosts */
+struct link_t {
+	int from;                 // index of first host
+	int to;                   // index of second host
+	int bandwidth;            // in bps
+	int mtu;                  // in bytes
+	int64_t propagationDelay; // in usec
+};
+
+/* a host and its links in the order cnet numbers them (link 1 first) */
+struct host_t {
+	std::string name;
+	int address;
+	int64_t messageRate;      // in usec
+	std::vector<int> links;   // indices into the link table
+	std::vector<int> weights; // weight of each link as get_weight() in network.c
+};
+
+/* a parametrized #define of a topology file */
+struct macro_t {
+	std::vector<std::string> params;
+	std::string body;
+};
+
+
+/**
+ * Reads a cnet topology file (including #include and #define directives)
+ * and provides its hosts and links.
+ */
+class Topology
+{
+public:
+	Topology(const std::string& file);
+	
+	const std::vector<host_t>& getHosts() const { return hosts; }
+	
+	const std::vector<link_t>& getLinks() const { return links; }
+	
+	/* host at the other end of link l of host h */
+	int neighbour(int h, int l) const;
+	
+	/* number of host with given address or -1 */
+	int findAddress(int address) const;
+	
+	/* position of link 'link' in the links of host h or -1 */
+	int linkIndex(int h, int link) const;
+	
+	/* weight host h uses for its link l */
+	int weight(int h, int l) const { return hosts[h].weights[l]; }
+	
+	void setWeight(int h, int l, int weight) { hosts[h].weights[l] = weight; }
+	
+	/* replaces weights by the ones of a weight file */
+	void readWeights(const std::string& file);
+	
+	/* writes the weights which differ from the bandwidth based ones */
+	void writeWeights(const std::string& file, const std::string& comment) const;
+	
+	/* bandwidth based weight of a link, like get_weight() in network.c */
+	static int defaultWeight(const link_t& link);
+	
+private:
+	
+	void preprocess(const std::string& file, std::string& out);
+	
+	std::string expand(const std::string& line);
+	
+	void tokenize(const std::string& text);
+	
+	void parse();
+	
+	void parseHost();
+	
+	void parseLink(int host);
+	
+	void parseAttribute(const std::string& name, host_t* host, link_t* link);
+	
+	int findHost(const std::string& name);
+	
+	bool isUnit(size_t pos) const;
+	
+	std::map<std::string, macro_t> macros;
+	std::vector<std::string> tokens;
+	size_t pos;
+	
+	link_t defaultLink;
+	int64_t defaultMessageRate;
+	std::vector<host_t> hosts;
+	std::vector<link_t> links;
+};
+
+#endif
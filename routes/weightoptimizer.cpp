@@ -0,0 +1,281 @@
+#include "weightoptimizer.h"
+
+#include <queue>
+#include <algorithm>
+#include <cstdlib>
+
+
+using namespace std;
+
+
+bool cost_t::operator<(const cost_t& other) const
+{
+	const double eps = 1e-9;
+	for(size_t i = 0; i < utilizations.size() && i < other.utilizations.size(); i++) {
+		if(utilizations[i] < other.utilizations[i] - eps) {
+			return true;
+		}
+		if(utilizations[i] > other.utilizations[i] + eps) {
+			return false;
+		}
+	}
+	return false;
+}
+
+
+WeightOptimizer::WeightOptimizer(const string& input, const string& output,
+                                 const string& matrix, int maxSteps)
+	: topology(input)
+{
+	const vector<host_t>& hosts = topology.getHosts();
+	for(size_t h = 0; h < hosts.size(); h++) {
+		firstEnd.push_back(ends.size());
+		for(size_t l = 0; l < hosts[h].links.size(); l++) {
+			ends.push_back(make_pair(h, l));
+		}
+	}
+
+	traffic.resize(hosts.size(), vector<double>(hosts.size(), 0));
+	if(matrix.empty()) {
+		defaultMatrix();
+	} else {
+		readMatrix(matrix);
+	}
+
+	cost_t initial = evaluate();
+	cost_t cost = initial;
+	int steps = 0;
+	while(steps < maxSteps && improve(cost)) {
+		steps++;
+	}
+
+	stringstream comment;
+	comment << "utilization of the 3 busiest links";
+	for(size_t i = 0; i < 3 && i < cost.utilizations.size(); i++) {
+		comment << (i ? ", " : " ") << initial.utilizations[i] << " -> " << cost.utilizations[i];
+	}
+	comment << " after " << steps << " steps";
+	topology.writeWeights(output, comment.str());
+	cout << hosts.size() << " nodes, " << topology.getLinks().size() << " links, "
+	     << comment.str() << ", weights written to " << output << endl;
+}
+
+/**
+ * Every host sends messages of AVERAGE_MESSAGE_SIZE bytes at its message
+ * rate, to all other hosts with the same probability, as cnet does.
+ */
+void WeightOptimizer::defaultMatrix()
+{
+	const vector<host_t>& hosts = topology.getHosts();
+	if(hosts.size() < 2) {
+		return;
+	}
+	for(size_t src = 0; src < hosts.size(); src++) {
+		double rate = 8. * AVERAGE_MESSAGE_SIZE * 1000000. / hosts[src].messageRate;
+		for(size_t dest = 0; dest < hosts.size(); dest++) {
+			if(dest != src) {
+				traffic[src][dest] = rate / (hosts.size() - 1);
+			}
+		}
+	}
+}
+
+/**
+ * Reads a traffic matrix. Each line holds the names of the source and
+ * destination host and the offered load in bps. Lines starting with #
+ * are comments, pairs which are not listed send nothing.
+ */
+void WeightOptimizer::readMatrix(const string& file)
+{
+	ifstream fin(file.c_str(), ios::in);
+	if(!fin) {
+		throw runtime_error("cannot open " + file);
+	}
+	const vector<host_t>& hosts = topology.getHosts();
+	string st;
+	while(getline(fin, st)) {
+		if(st.empty() || st[0] == '#') {
+			continue;
+		}
+		stringstream h(st);
+		string from, to;
+		double rate;
+		if(!(h >> from >> to >> rate)) {
+			throw runtime_error("malformed line in " + file + ": " + st);
+		}
+		int src = -1, dest = -1;
+		for(size_t i = 0; i < hosts.size(); i++) {
+			if(hosts[i].name == from) {
+				src = i;
+			}
+			if(hosts[i].name == to) {
+				dest = i;
+			}
+		}
+		if(src < 0 || dest < 0) {
+			throw runtime_error("unknown host in " + file + ": " + st);
+		}
+		traffic[src][dest] += rate;
+	}
+	fin.close();
+}
+
+/**
+ * Computes the next hop (link index) of every node towards 'dest' the
+ * distance vector routing converges to, like RouteCompiler::computeRoutes().
+ * Nodes which cannot reach 'dest' get -1.
+ */
+void WeightOptimizer::nextHops(int dest, vector<int>& next) const
+{
+	const vector<host_t>& hosts = topology.getHosts();
+	int n = hosts.size();
+
+	vector<int> weight(n, ROUTING_INFINITY);
+	vector<bool> done(n, false);
+	priority_queue<pair<int, int>, vector<pair<int, int> >, greater<pair<int, int> > > queue;
+	weight[dest] = 0;
+	queue.push(make_pair(0, dest));
+
+	while(!queue.empty()) {
+		int node = queue.top().second;
+		queue.pop();
+		if(done[node]) {
+			continue;
+		}
+		done[node] = true;
+		for(size_t l = 0; l < hosts[node].links.size(); l++) {
+			int other = topology.neighbour(node, l);
+			int w = min<int64_t>(2LL * weight[node] + topology.weight(other, topology.linkIndex(other, hosts[node].links[l])),
+			                     ROUTING_INFINITY);
+			if(w < weight[other]) {
+				weight[other] = w;
+				queue.push(make_pair(w, other));
+			}
+		}
+	}
+
+	//the first link with the lowest weight, as best_route() chooses it
+	next.assign(n, -1);
+	for(int node = 0; node < n; node++) {
+		int bestWeight = ROUTING_INFINITY;
+		for(size_t l = 0; node != dest && l < hosts[node].links.size(); l++) {
+			int other = topology.neighbour(node, l);
+			if(weight[other] >= ROUTING_INFINITY) {
+				continue;
+			}
+			int w = min<int64_t>(2LL * weight[other] + topology.weight(node, l), ROUTING_INFINITY);
+			if(w < bestWeight) {
+				bestWeight = w;
+				next[node] = l;
+			}
+		}
+	}
+}
+
+/**
+ * Routes the traffic matrix with the current weights and returns the
+ * cost. The utilization of each directed link is stored if requested.
+ */
+cost_t WeightOptimizer::evaluate(vector<double>* utilization) const
+{
+	const vector<host_t>& hosts = topology.getHosts();
+	const vector<link_t>& links = topology.getLinks();
+	int n = hosts.size();
+	vector<double> load(ends.size(), 0);
+	vector<int> next;
+
+	for(int dest = 0; dest < n; dest++) {
+		nextHops(dest, next);
+		for(int src = 0; src < n; src++) {
+			if(traffic[src][dest] <= 0) {
+				continue;
+			}
+			//the hop limit guards against loops of routes cut down to infinity
+			for(int node = src, hops = 0; node != dest && next[node] >= 0 && hops < n; hops++) {
+				load[firstEnd[node] + next[node]] += traffic[src][dest];
+				node = topology.neighbour(node, next[node]);
+			}
+		}
+	}
+
+	for(size_t d = 0; d < ends.size(); d++) {
+		load[d] /= links[hosts[ends[d].first].links[ends[d].second]].bandwidth;
+	}
+	cost_t cost;
+	cost.utilizations = load;
+	sort(cost.utilizations.rbegin(), cost.utilizations.rend());
+	if(utilization != NULL) {
+		utilization->swap(load);
+	}
+	return cost;
+}
+
+/**
+ * One step of the local search: raises the weight of one of the most
+ * utilized links or lowers the weight of one of the least utilized links.
+ * The first change which lowers the cost is kept.
+ *
+ * @return Whether the cost could be lowered.
+ */
+bool WeightOptimizer::improve(cost_t& cost)
+{
+	vector<double> utilization;
+	evaluate(&utilization);
+
+	vector<pair<double, int> > order;
+	for(size_t d = 0; d < ends.size(); d++) {
+		order.push_back(make_pair(-utilization[d], d));
+	}
+	sort(order.begin(), order.end());
+
+	static const double raise[] = {1.25, 2, 4};
+	int candidates = min<int>(CANDIDATE_LINKS, order.size());
+
+	for(int c = 0; c < 2 * candidates; c++) {
+		//most utilized links first, then the least utilized ones
+		int d = c < candidates ? order[c].second : order[order.size() - 1 - (c - candidates)].second;
+		int h = ends[d].first, l = ends[d].second;
+		int old = topology.weight(h, l);
+
+		vector<int> tries;
+		if(c < candidates) {
+			for(size_t f = 0; f < sizeof(raise) / sizeof(raise[0]); f++) {
+				tries.push_back(min(max((int) (old * raise[f]), old + 1), MAX_LINK_WEIGHT));
+			}
+		} else if(old > 1) {
+			//weight 0 would let routes loop at no cost
+			tries.push_back(max(1, old / 2));
+		}
+
+		for(size_t t = 0; t < tries.size(); t++) {
+			if(tries[t] == old) {
+				continue;
+			}
+			topology.setWeight(h, l, tries[t]);
+			cost_t newCost = evaluate();
+			if(newCost < cost) {
+				cost = newCost;
+				return true;
+			}
+		}
+		topology.setWeight(h, l, old);
+	}
+	return false;
+}
+
+
+int main(int argc, char** argv)
+{
+	if(argc >= 3) {
+		try {
+			WeightOptimizer o(argv[1], argv[2], argc >= 4 ? argv[3] : "",
+			                  argc >= 5 ? atoi(argv[4]) : 1000);
+		} catch(const exception& e) {
+			cerr << argv[0] << ": " << e.what() << endl;
+			return 1;
+		}
+	} else {
+		std::cout << "usage: " << argv[0] << " <topology> <output> [traffic matrix] [steps]" << std::endl;
+	}
+	return 0;
+}
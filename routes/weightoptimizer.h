@@ -0,0 +1,65 @@
+#ifndef WEIGHTOPTIMIZER_H
+#define WEIGHTOPTIMIZER_H
+
+#include "topology.h"
+#include "../weights.h"
+
+/* average message size in bytes the messagerate comments assume */
+#define AVERAGE_MESSAGE_SIZE 2000
+
+/* largest weight the search assigns to a link */
+#define MAX_LINK_WEIGHT (1 << 16)
+
+/* number of most and least utilized links tried in each step */
+#define CANDIDATE_LINKS 16
+
+
+/**
+ * Quality of a weight setting: the utilizations of all directed links in
+ * descending order, compared lexicographically. Besides the maximum this
+ * also lowers the next highest utilizations, which matters when the most
+ * utilized link cannot be avoided.
+ */
+struct cost_t {
+	std::vector<double> utilizations;
+
+	bool operator<(const cost_t& other) const;
+};
+
+
+/**
+ * Searches link weights for the distance vector routing of network.c which
+ * minimize the maximum link utilization under a known traffic matrix.
+ */
+class WeightOptimizer
+{
+public:
+	WeightOptimizer(const std::string& input, const std::string& output,
+	                const std::string& matrix, int maxSteps);
+
+
+private:
+
+	void readMatrix(const std::string& file);
+
+	void defaultMatrix();
+
+	cost_t evaluate(std::vector<double>* utilization = NULL) const;
+
+	void nextHops(int dest, std::vector<int>& next) const;
+
+	bool improve(cost_t& cost);
+
+	Topology topology;
+
+	//source, destination -> offered load in bps
+	std::vector<std::vector<double> > traffic;
+
+	//directed link -> host and its link the traffic leaves on
+	std::vector<std::pair<int, int> > ends;
+
+	//host -> index of the directed link of its first link
+	std::vector<int> firstEnd;
+};
+
+#endif
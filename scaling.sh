@@ -0,0 +1,67 @@
+#!/bin/bash
+
+#
+# scaling.sh
+#
+# @autors Stefan Tombers, Alexander Bunte, Jonas Bürse
+#
+# Short script to evaluate the protocol stack on large synthetic networks.
+# For each given size it generates a topology of that many hosts, a ring
+# with one random shortcut per host, and runs benchmark.sh on it.
+# Networks with more than 256 hosts need ADDRESS_BITS 16 in datatypes.h.
+#
+
+#$1 = period of execution
+#$2... = number of hosts per topology, e.g. 250 500 1000
+
+if [ $# -lt 2 ]; then
+	echo "usage: $0 <period> <hosts>..."
+	exit 1
+fi
+
+period=$1
+shift
+
+topologies=""
+for hosts in "$@"; do
+	topology=synthetic-$hosts.txt
+	awk -v n=$hosts 'BEGIN {
+		srand(n)
+		for (i = 0; i < n; i++) {
+			degree[i] = 0
+		}
+		for (i = 0; i < n; i++) {
+			j = (i + 1) % n
+			adj[i, degree[i]++] = j
+			adj[j, degree[j]++] = i
+			j = int(rand() * n)
+			if (j != i && j != (i + 1) % n && j != (i + n - 1) % n) {
+				adj[i, degree[i]++] = j
+				adj[j, degree[j]++] = i
+			}
+		}
+
+		print "// Synthetic topology with " n " hosts generated by scaling.sh"
+		print ""
+		print "compile = \"milestone3.c\""
+		print ""
+		print "#include \"linktypes.txt\""
+		print ""
+		print "messagerate = 100ms"
+		print ""
+		for (i = 0; i < n; i++) {
+			printf "host N%d {\n", i
+			printf "\tx = %d, y = %d\n", int(rand() * 78000), int(rand() * 60000)
+			printf "\taddress = %d\n\n", i + 1
+			for (k = 0; k < degree[i]; k++) {
+				printf "\twan to N%d { LINK_STD(%d, 1000) }\n", adj[i, k], 1 + (i + adj[i, k]) % 10
+			}
+			print "}\n"
+		}
+	}' > $topology
+	topologies="$topologies $topology"
+done
+
+./benchmark.sh $period $topologies
+
+rm -f $topologies
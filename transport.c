@@ -10,9 +10,43 @@
  * and resending of unacknowledged segments.
  * 
  * For flow control a sliding window of maximal sendable segments is 
- * maintained. The max window size depends on the number of open
- * connections. The Reno algorithm is used for adapting the window size
- * to the current network congestion.
+ * maintained. The max window size is twice the bandwidth-delay product
+ * of the route, up to MAX_WINDOW_SIZE segments. A congestion control algorithm (see congestion.c, selected
+ * per node at boot) adapts the window size to the current network
+ * congestion. It learns about acknowledgments, duplicated acknowledgments
+ * and timeouts, and once per round trip when the receiver echoes that the
+ * network layer marked data as congested (ECN). When the network layer reports a new
+ * route, the RTT estimation, window limit and segment size are adapted.
+ *
+ * Each connection has a single retransmission timer (RFC 6298) which runs
+ * while data are unacknowledged and is restarted whenever an ACK makes
+ * progress. When it expires the first unacknowledged segment is resent and
+ * the timeout is doubled. RTT samples of retransmitted segments are
+ * ambiguous and ignored (Karn's rule), unless timestamps are used.
+ *
+ * Acknowledgments carry the ranges the receiver holds behind the
+ * acknowledged offset (SACK), as far as the segment has room for them.
+ * The sender marks these segments and resends only the ones reported lost.
+ *
+ * Received data are acknowledged by the next segment in the other direction.
+ * If none is sent, an explicit ACK follows after ACK_EVERY segments or once
+ * the delayed ACK timer expires, at once for out of order data and
+ * segments filling a hole, so the sender learns about losses quickly.
+ *
+ * Connections are stored in a table indexed by the address of the connected
+ * node. Their buffers grow with the data they hold; connections without
+ * traffic for IDLE_TIME give them back, but keep their sequence state.
+ *
+ * While data are unacknowledged, a segment which is not full is held back
+ * (Nagle), and following small messages are appended to it. It is released
+ * when it is full, all data are acknowledged or after COALESCE_TIME.
+ * The ends of the messages inside a segment precede its payload.
+ *
+ * New segments are paced: each connection sends at most a window per
+ * round trip time, spread evenly, and never faster than the bottleneck
+ * of its route. A single pacing timer per node serves the connections
+ * with queued segments in deficit round robin order and holds them back
+ * while the queue of their first link is long.
  *
  */
 
@@ -27,19 +61,43 @@
 #include "network.h"
 #include "transport.h"
 #include "buffer.h"
-#include "dring.h"
+#include "boundary.h"
+#include "addrmap.h"
+#include "congestion.h"
 
 
 /**
- * Size of a segment in byte.
+ * Maximal size of a segment's payload in byte.
+ * Segments are smaller if the path MTU requires it.
  */
 #define SEGMENT_SIZE 1024
 
+/**
+ * Minimal size of a segment's payload in byte.
+ */
+#define MIN_SEGMENT_SIZE 32
+
 /**
  * Maximal number of segments in storage and under transmission.
  */
+#define MAX_WINDOW_SIZE 1024
+
+/**
+ * Minimal window limit in segments, enough to get an ACK without
+ * waiting for the delayed ACK timer.
+ */
+#define MIN_WINDOW_LIMIT 4
 
-#define MAX_WINDOW_SIZE 32
+/**
+ * The window limit is this multiple of the bandwidth-delay product
+ * of the route, to leave room for delayed ACKs and variations of the RTT.
+ */
+#define WINDOW_BDP_GAIN 2
+
+/**
+ * Number of out segments space is allocated for at first.
+ */
+#define INITIAL_OUT_SEGMENTS 32
 
 /**
  * Maximal offset of the window in byte.
@@ -47,30 +105,83 @@
 #define MAX_WINDOW_OFFSET (MAX_WINDOW_SIZE * SEGMENT_SIZE)
 
 /**
- * Timeout in usec when a segment needs to be resend.
+ * Timeout in usec when a segment needs to be resend,
+ * as long as no RTT was measured.
  */
 #define TRANSPORT_TIMEOUT 1000000
 
 /**
- * Maximal offset of the segment in byte (UINT15).
+ * Bounds of the retransmission timeout in usec.
+ * The upper one caps the exponential backoff.
+ */
+#define MIN_TRANSPORT_TIMEOUT 20000
+#define MAX_TRANSPORT_TIMEOUT 60000000
+
+/**
+ * Number of bits of an offset. The bits above carry the flags
+ * of the marshaled header.
  */
-#define MAX_SEGMENT_OFFSET (1 << 18)
+#define OFFSET_BITS 28
 
 /**
- * Maximal offset of the segment in byte (UINT15).
+ * Maximal offset of the segment in byte.
+ */
+#define MAX_SEGMENT_OFFSET (1 << OFFSET_BITS)
+
+/**
+ * Length of the receive buffer, the offsets of the data are its positions.
+ * Memory is only allocated for the data it holds.
  */
 #define TRANSPORT_BUFFER_SIZE MAX_SEGMENT_OFFSET
 
 /**
- * Minimum time before we send another ACK.
+ * Maximal distance in byte of received data to the first byte of the first
+ * incomplete message: a window behind the end of an incomplete message.
+ * Data beyond are dropped.
+ */
+#define RECEIVE_WINDOW (MAX_WINDOW_OFFSET + MAX_MESSAGE_SIZE)
+
+/**
+ * The number of sack blocks is encoded in the acknowledgment offset,
+ * above the congestion echo bit.
+ */
+#define SACK_SHIFT (OFFSET_BITS + 1)
+
+/**
+ * The number of message ends inside a segment is encoded in its offset,
+ * above the isLast bit.
+ */
+#define BOUNDARY_SHIFT (OFFSET_BITS + 1)
+
+/**
+ * Number of duplicated ACKs which indicate a lost segment,
+ * must match DUPACK_THRESHOLD in congestion.c.
  */
-#define ACK_TIME 10000
+#define DUPACK_THRESHOLD 3
+
+
+/**
+ * If true, newly created segments are paced instead of being handed to the
+ * lower layers at once, to not overwhelm them.
+ */
+#define USE_PACING true
+
+/**
+ * Bytes a connection may send per round of the pacer.
+ */
+#define PACING_QUANTUM SEGMENT_SIZE
+
+/**
+ * Queue delay in usec of the first link above which the pacer holds
+ * segments back.
+ */
+#define MAX_QUEUE_DELAY 50000
 
 /**
- * If true, newly created segments are transmitted asynchronously,
- * to not overwhelm the lower layers.
+ * Maximal time in usec a segment, which is not full, is held back to append
+ * further messages.
  */
-#define USE_GEARING true
+#define COALESCE_TIME 10000
 
 /**
  * If true, segments are explicitly acknowledged, when it is unlikely,
@@ -79,10 +190,89 @@
 #define EXPLICIT_ACK true
 
 /**
- * If true, the first sent segment still waiting for acknowledgment
- * is retransmitted after receiving three times the same acknowledgment.
+ * Number of received segments after which an explicit ACK is due.
+ */
+#define ACK_EVERY 2
+
+/**
+ * Maximal time in usec an explicit ACK is delayed.
+ */
+#define DELAYED_ACK_TIME 10000
+
+/**
+ * Time in usec a due ACK is held back if a segment, which could piggyback
+ * it, is sent in the other direction within this time.
+ */
+#define ACK_HOLD_TIME 2000
+
+/**
+ * If true, the ACK counters of the node are printed on shutdown.
+ */
+#define ACK_STATS false
+
+/**
+ * Time in usec without sent or received data after which a connection
+ * releases its buffers.
+ */
+#define IDLE_TIME 5000000
+
+/**
+ * If true, the memory the transport layer of the node allocated is printed
+ * on shutdown.
+ */
+#define MEMORY_STATS false
+
+/**
+ * Congestion control algorithm of the node: reno, newreno, cubic or bbr.
+ * It can be chosen per node in CONGESTION_FILE.
+ */
+#define CONGESTION_CONTROL "newreno"
+
+/**
+ * File which assigns congestion control algorithms to nodes,
+ * see congestion_load().
+ */
+#define CONGESTION_FILE "congestion.txt"
+
+/**
+ * A connection sends in the latency traffic class if the message which
+ * starts its data after all were acknowledged is at most this size in
+ * byte, in the bulk class otherwise. Acknowledgments are always latency
+ * traffic.
+ */
+#define LATENCY_MESSAGE_SIZE 1024
+
+
+/**
+ * Data structure for one out segment. Out segments are segments which are not
+ * acknowledged. These segments are not send or waiting for acknowledgment
+ * (waiting in queue). The payload stays in the send buffer of the connection,
+ * the header is marshaled when the segment is transmitted.
+ */
+typedef struct
+{
+	CnetTime sendTime;        // Time when the segment was send last.
+	bool inFlight;            // Scheduled or sent, waiting for acknowledgment.
+	bool sacked;              // Reported received by a selective acknowledgment.
+	bool sackResent;          // Resent since it was reported lost.
+	size_t size;              // Size of the payload
+	bool isLast;              // Last segment of a message
+	int timesSend;						// number of times this segment was already transmitted
+	uint32_t offset;					// offset of the segments payload
+	bool held;                // Not full, held back for further messages.
+	uint8_t numBounds;        // Number of message ends inside the payload.
+	uint16_t bounds[MAX_SEGMENT_BOUNDARIES]; // Message ends relative to offset.
+} OUT_SEGMENT;
+
+
+/**
+ * A segment with at most SEGMENT_SIZE bytes of payload, laid out like SEGMENT.
  */
-#define USE_RENO true
+typedef struct
+{
+	marshaled_segment_header header;
+	char payload[SEGMENT_SIZE];
+} SMALL_SEGMENT;
 
 
 /**
@@ -92,41 +282,72 @@ typedef struct
 {
   /* for receiving */
 	BUFFER inBuf;           // Buffer for incoming data.
-	DRING lasts;            // Stores the cyclic sequence numbers which are received.
+	BOUNDARY lasts;         // Stores the end offsets of received messages.
 	size_t bufferStart;     // First byte of first incomplete message.
 
 	/* for sending */
-	VECTOR outSegments;     // Sent and queued segments without a received ACK.
+	char *sendBuf;          // Unacknowledged data, byte 'offset' at offset % sendCapacity.
+	size_t sendCapacity;    // Size of sendBuf (power of 2, divides MAX_SEGMENT_OFFSET).
+	OUT_SEGMENT *outSegments; // Ring of sent and queued segments without a received ACK.
+	uint16_t outCapacity;   // Size of the ring (power of 2).
+	uint16_t outFirst;      // Id of the first out segment, at position id % outCapacity.
+	uint16_t outCount;      // Number of out segments.
 	size_t numSentSegments; // Which of the outSegments have been send (which is the next segment to send).
-	size_t windowSize;      // Size of the window.
-	size_t threshold;       // When to stop the slow start phase
+	size_t windowSize;      // Size of the window, the congestion window of cc.
+	CONGESTION cc;          // Congestion control of the connection.
 	size_t windowLimit;	    // Maximal size of window
 	size_t nextOffset;      // The next offset the connection will send if the window moves. Initially it is 0.
+	size_t segmentSize;     // Payload size of new segments, fits into the path MTU.
+	int tclass;             // Traffic class of the data, changes only while all are acknowledged.
 
 	CnetAddr addr;          // Address of the connected node
 	CnetTime estimatedRTT;  // Estimated round time trip (RTT).
 	CnetTime deviation;	    // Safety margin for the variation in estimatedRTT.
-	CnetTime lastSendAck;   // Time the last acknowledgment was transmitted
-	int ackCounter;	        // Congestion control: counts duplicated ACKs
-	size_t lastAckOffset;   // Congestion control: stores the last ACK received
+	CnetTime timeout;       // Retransmission timeout, doubled on every expiry.
+	CnetTimerID rtoTimer;   // Retransmission timer, -1 if it is not running.
+	uint32_t tsRecent;      // Timestamp to echo to the connected node.
+	bool rttProbe;          // The route changed, the next RTT sample restarts the estimation.
+	int ackPending;         // ACK policy: segments received since the last acknowledgment
+	CnetTimerID ackTimer;   // ACK policy: delayed ACK timer, -1 if it is not running
+	CnetTimerID coalesceTimer; // Coalescing: releases the held segment, -1 if it is not running
+	int ackCounter;	        // Fast retransmit: counts duplicated ACKs
+	size_t lastAckOffset;   // Fast retransmit: stores the last ACK received
+	bool ecnEcho;           // Congestion control: received congested data which is not echoed yet
+	CnetTime lastEcnCut;    // Congestion control: time the window was reduced due to an echo
+	int bandwidth;          // Minimum bandwidth on the route, 0 if unknown
+	CnetTime nextSendTime;  // Pacing: earliest time the next segment may be sent
+	int deficit;            // Pacing: bytes the connection may still send in this round
+	bool paced;             // Pacing: the connection is in the list of the pacer
+	CnetTime lastActivity;  // Time data were last sent or received
 } CONNECTION;
 
 
 /**
- * Data structure for one out segment. Out segments are segments which are not
- * acknowledged. These segments are not send or waiting for acknowledgment
- * (waiting in queue).
+ * Data structure for the pacer: a ring of the addresses of connections
+ * with queued segments, served in round robin order.
  */
 typedef struct
 {
-	CnetTime sendTime;        // Time when the segment was send last.
-	CnetTimerID timerId;      // The ID of the timer to count the timeout.
-	CnetAddr addr;            // The destination address of the segment.
-	size_t size;              // Size of the out segment
-	SEGMENT *seg;             // Pointer to the data stored in the segment.
-	int timesSend;						// number of times this segment was already transmitted
-	uint32_t offset;					// offset of the segments payload
-} OUT_SEGMENT;
+	CnetAddr *addrs;        // Addresses, the first one at position first % capacity.
+	int capacity;           // Size of the ring (power of 2).
+	int first;              // Position of the connection served next.
+	int count;              // Number of connections in the ring.
+	CnetTimerID timer;      // The pacing timer, -1 if it is not running.
+	CnetTime time;          // Time the pacing timer expires.
+} PACER;
+
+
+/**
+ * Counters of the ACK policy, to compare the ACKs sent with one explicit ACK
+ * per received segment.
+ */
+typedef struct
+{
+	size_t segments;        // Received data segments.
+	size_t acks;            // Explicit acknowledgments sent.
+	size_t ackBytes;        // Bytes of the explicit acknowledgments.
+	size_t piggybacked;     // Acknowledgments carried by data segments.
+} ACK_COUNTERS;
 
 
 /**
@@ -135,27 +356,83 @@ typedef struct
  * 
  * host address -> CONNECTION
  */
-HASHTABLE connections;
+ADDRMAP connections;
+
+/**
+ * The pacer of the host.
+ */
+PACER pacer;
+
+/**
+ * The ACK counters of the host.
+ */
+ACK_COUNTERS ackCounters;
+
+/**
+ * Time the idle connections were last compacted.
+ */
+CnetTime lastCompaction;
 
 
 CONNECTION* get_connection(CnetAddr addr);
 CnetTime get_timeout(CONNECTION *con);
+CnetTime smoothed_rtt(CONNECTION *con);
 
 
 /**
  * Updates window limit for the given connection
- * dependent on the number of open connections and the connections bandwidth.
+ * dependent on the bandwidth-delay product of its route.
+ * As long as no RTT was measured, or the bandwidth is unknown,
+ * the congestion control alone limits the window.
  * 
  * @param con The connection for which the window limit should be updated.
+ * @param bandwidth Minimum bandwidth on the route to the connected node.
+ */
+void update_window_limit(CONNECTION *con, int bandwidth)
+{
+	CnetTime srtt = smoothed_rtt(con);
+
+	con->bandwidth = bandwidth;
+
+	if (srtt > 0 && bandwidth > 0) {
+		double bdp = (double) bandwidth / 8 * srtt / 1000000; // in byte
+		con->windowLimit = WINDOW_BDP_GAIN * bdp / con->segmentSize;
+		con->windowLimit = MIN(con->windowLimit, MAX_WINDOW_SIZE);  // limit windowLimit
+		con->windowLimit = MAX(con->windowLimit, MIN_WINDOW_LIMIT); // ensure window limit is >0
+	} else {
+		con->windowLimit = MAX_WINDOW_SIZE;
+	}
+
+	congestion_set_path(con->cc, con->windowLimit, con->segmentSize);
+	con->windowSize = congestion_cwnd(con->cc);
+}
+
+
+/**
+ * Updates the payload size of new segments for the given connection,
+ * such that a segment is sent in a single frame on every link to the
+ * destination.
+ *
+ * @param con The connection for which the segment size should be updated.
+ * @param pathMTU Largest segment the route carries in single frames, 0 if unknown.
  */
-void update_window_limit(CONNECTION *con)
+void update_segment_size(CONNECTION *con, int pathMTU)
 {
-	int maxWindow = MAX_WINDOW_SIZE;
-	
-	con->windowLimit = ((maxWindow - hashtable_nitems(connections))
-											* network_get_bandwidth(con->addr)) / 10000000;
-	con->windowLimit = MIN(con->windowLimit, maxWindow);  // limit windowLimit
-	con->windowLimit = MAX(con->windowLimit, 1);          // ensure window limit is >0
+	size_t segmentSize = SEGMENT_SIZE;
+
+	if (pathMTU > 0) {
+		segmentSize = pathMTU - sizeof(marshaled_segment_header);
+		segmentSize = MIN(segmentSize, SEGMENT_SIZE);
+		segmentSize = MAX(segmentSize, MIN_SEGMENT_SIZE);
+	}
+
+	#if LOGGING == true
+	if (segmentSize != con->segmentSize) {
+		printf("%lld: [segment_size] to_node: %d size: %d\n", nodeinfo.time_in_usec, con->addr, (int) segmentSize);
+	}
+	#endif
+	con->segmentSize = segmentSize;
+	congestion_set_path(con->cc, con->windowLimit, con->segmentSize);
 }
 
 
@@ -177,28 +454,44 @@ CONNECTION *create_connection(CnetAddr addr)
 	CONNECTION con;
 
 	con.inBuf = buffer_new(TRANSPORT_BUFFER_SIZE);
-	con.lasts = dring_new(MAX_WINDOW_OFFSET);
+	/* ends lie at most a window behind the first incomplete message */
+	con.lasts = boundary_new(RECEIVE_WINDOW, MAX_SEGMENT_OFFSET);
 	con.bufferStart = 0;
-	con.outSegments = vector_new();
+	con.sendBuf = NULL;
+	con.sendCapacity = 0;
+	con.outSegments = NULL;
+	con.outCapacity = 0;
+	con.outFirst = 0;
+	con.outCount = 0;
 	con.numSentSegments = 0;
 	con.windowSize = 1;
-	con.threshold = 8;
+	con.windowLimit = MAX_WINDOW_SIZE;
+	con.cc = congestion_new(con.windowLimit, SEGMENT_SIZE);
 	con.nextOffset = 0;
+	con.segmentSize = SEGMENT_SIZE;
+	con.tclass = CLASS_BULK;
 	con.addr = addr;
 	con.estimatedRTT = TRANSPORT_TIMEOUT;
 	con.deviation = TRANSPORT_TIMEOUT;
-	con.lastSendAck = 0;
+	con.timeout = TRANSPORT_TIMEOUT;
+	con.rtoTimer = -1;
+	con.tsRecent = 0;
+	con.rttProbe = false;
+	con.ackPending = 0;
+	con.ackTimer = -1;
+	con.coalesceTimer = -1;
 	con.ackCounter = 0;
 	con.lastAckOffset = 0;
-
-	char key[5];
-	int2string(key, addr);
-	assert(!hashtable_find(connections, key, NULL));
-	hashtable_add(connections, key, &con, sizeof(con));
-
-	CONNECTION *ret = hashtable_find(connections, key, NULL);
-
-	return ret;
+	con.ecnEcho = false;
+	con.lastEcnCut = 0;
+	con.bandwidth = 0;
+	con.nextSendTime = 0;
+	con.deficit = 0;
+	con.paced = false;
+	con.lastActivity = nodeinfo.time_in_usec;
+
+	assert(!addrmap_find(connections, addr));
+	return addrmap_add(connections, addr, &con);
 }
 
 
@@ -211,9 +504,7 @@ CONNECTION *create_connection(CnetAddr addr)
  */
 CONNECTION* get_connection(CnetAddr addr)
 {
-	char key[5];
-	int2string(key, addr);
-	CONNECTION *con = hashtable_find(connections, key, NULL);
+	CONNECTION *con = addrmap_find(connections, addr);
 
 	if (con == NULL) {
 		con = create_connection(addr);
@@ -223,6 +514,188 @@ CONNECTION* get_connection(CnetAddr addr)
 }
 
 
+/**
+ * Releases the buffers of a connection which neither waits for an
+ * acknowledgment nor holds parts of a message. The sequence state is kept,
+ * the buffers are allocated again when data are sent or received.
+ *
+ * @param con The connection.
+ */
+void compact_connection(CONNECTION *con)
+{
+	if (con->outCount > 0 || con->paced) {
+		return;
+	}
+
+	free(con->sendBuf);
+	con->sendBuf = NULL;
+	con->sendCapacity = 0;
+	free(con->outSegments);
+	con->outSegments = NULL;
+	con->outCapacity = 0;
+	buffer_compact(con->inBuf);
+
+	#if LOGGING == true
+	printf("%lld: [compact_connection] to_node: %d\n", nodeinfo.time_in_usec, con->addr);
+	#endif
+}
+
+
+/**
+ * Compacts the connections without traffic for IDLE_TIME,
+ * at most once per IDLE_TIME.
+ */
+void compact_idle_connections()
+{
+	if (nodeinfo.time_in_usec - lastCompaction < IDLE_TIME) {
+		return;
+	}
+	lastCompaction = nodeinfo.time_in_usec;
+
+	CONNECTION *con;
+	for (CnetAddr addr = 0; (con = addrmap_next(connections, &addr)) != NULL; addr++) {
+		if (nodeinfo.time_in_usec - con->lastActivity >= IDLE_TIME) {
+			compact_connection(con);
+		}
+	}
+}
+
+
+/**
+ * Returns the number of bytes the transport layer of the node allocated
+ * for its connections and the pacer.
+ *
+ * @return Allocated bytes.
+ */
+size_t transport_memory()
+{
+	size_t bytes = addrmap_memory(connections) + pacer.capacity * sizeof(*pacer.addrs);
+
+	CONNECTION *con;
+	for (CnetAddr addr = 0; (con = addrmap_next(connections, &addr)) != NULL; addr++) {
+		bytes += buffer_memory(con->inBuf) + boundary_memory(con->lasts);
+		bytes += con->sendCapacity + con->outCapacity * sizeof(*con->outSegments);
+		bytes += congestion_memory(con->cc);
+	}
+	return bytes;
+}
+
+
+/**
+ * Returns the out segment with the given id,
+ * NULL if it has been acknowledged already.
+ *
+ * @param con The connection.
+ * @param id Id of the out segment.
+ * @return The out segment or NULL.
+ */
+OUT_SEGMENT *out_segment_by_id(CONNECTION *con, uint16_t id)
+{
+	if ((uint16_t) (id - con->outFirst) >= con->outCount) {
+		return NULL;
+	}
+	return &con->outSegments[id & (con->outCapacity - 1)];
+}
+
+
+/**
+ * Returns the i-th out segment of a connection, NULL if there are fewer.
+ *
+ * @param con The connection.
+ * @param i Index of the out segment, 0 is the first unacknowledged one.
+ * @return The out segment or NULL.
+ */
+OUT_SEGMENT *out_segment(CONNECTION *con, int i)
+{
+	if (i >= con->outCount) {
+		return NULL;
+	}
+	return out_segment_by_id(con, con->outFirst + i);
+}
+
+
+/**
+ * Appends an out segment to the ring of a connection.
+ * The ring is doubled if it is full.
+ *
+ * @param con The connection.
+ * @return The new out segment.
+ */
+OUT_SEGMENT *append_out_segment(CONNECTION *con)
+{
+	if (con->outCount == con->outCapacity) {
+		uint16_t capacity = con->outCapacity > 0 ? 2 * con->outCapacity : INITIAL_OUT_SEGMENTS;
+		OUT_SEGMENT *ring = malloc(capacity * sizeof(*ring));
+
+		assert(capacity > con->outCapacity); // at most 2^15 out segments
+		for (uint16_t id = con->outFirst; id != (uint16_t) (con->outFirst + con->outCount); id++) {
+			ring[id & (capacity - 1)] = con->outSegments[id & (con->outCapacity - 1)];
+		}
+		free(con->outSegments);
+		con->outSegments = ring;
+		con->outCapacity = capacity;
+	}
+
+	con->outCount++;
+	return out_segment(con, con->outCount - 1);
+}
+
+
+/**
+ * Copies data of a connection into its send buffer at offset 'offset'.
+ * The buffer is doubled until it holds all unacknowledged data.
+ *
+ * @param con The connection.
+ * @param offset Offset of the data, the next offset of the connection.
+ * @param data The data.
+ * @param size Size of the data.
+ */
+void send_buffer_store(CONNECTION *con, size_t offset, char *data, size_t size)
+{
+	size_t first = con->outCount > 0 ? out_segment(con, 0)->offset : offset;
+	size_t used  = (offset - first + MAX_SEGMENT_OFFSET) % MAX_SEGMENT_OFFSET;
+
+	if (used + size > con->sendCapacity) {
+		size_t capacity = con->sendCapacity > 0 ? con->sendCapacity : SEGMENT_SIZE;
+		while (capacity < used + size) {
+			capacity *= 2;
+		}
+		assert(capacity <= MAX_SEGMENT_OFFSET);
+
+		char *buf = malloc(capacity);
+		for (size_t i = 0; i < used; i++) {
+			size_t o = (first + i) % MAX_SEGMENT_OFFSET;
+			buf[o & (capacity - 1)] = con->sendBuf[o & (con->sendCapacity - 1)];
+		}
+		free(con->sendBuf);
+		con->sendBuf = buf;
+		con->sendCapacity = capacity;
+	}
+
+	size_t pos  = offset & (con->sendCapacity - 1);
+	size_t part = MIN(size, con->sendCapacity - pos);
+	memcpy(con->sendBuf + pos, data, part);
+	memcpy(con->sendBuf, data + part, size - part);
+}
+
+
+/**
+ * Copies data of a connection from its send buffer.
+ *
+ * @param con The connection.
+ * @param offset Offset of the data.
+ * @param data Where to copy the data to.
+ * @param size Size of the data.
+ */
+void send_buffer_load(CONNECTION *con, size_t offset, char *data, size_t size)
+{
+	size_t pos  = offset & (con->sendCapacity - 1);
+	size_t part = MIN(size, con->sendCapacity - pos);
+	memcpy(data, con->sendBuf + pos, part);
+	memcpy(data + part, con->sendBuf, size - part);
+}
+
+
 /**
  * Checks whether offset is affected by ackOffset.
  * Returns true if offset has already been acknowledged.
@@ -241,11 +714,26 @@ bool acknowledged(size_t offset, size_t ackOffset)
 }
 
 
+/**
+ * Recomputes the retransmission timeout of the given connection
+ * from its RTT estimation. This also ends a backoff.
+ *
+ * @param con The connection.
+ */
+void update_timeout(CONNECTION *con)
+{
+	CnetTime timeout = con->estimatedRTT + 4 * con->deviation;
+
+	timeout = MAX(timeout, MIN_TRANSPORT_TIMEOUT);
+	con->timeout = MIN(timeout, MAX_TRANSPORT_TIMEOUT);
+}
+
+
 /**
  * Updates the estimatedRTT and the Deviation value
  * of the given connection with the given sampleRTT.
  * The calculation to estimate the RTT is based on
- * exponential weighted moving average.
+ * exponential weighted moving average (RFC 6298).
  * 
  * @param con The connection for that RTT should be updated.
  * @param sampleRTT New measured RTT.
@@ -255,12 +743,17 @@ void update_rtt(CONNECTION *con, CnetTime sampleRTT)
 	double x = 0.125;
 	double y = 0.25;
 
-	if (con->estimatedRTT != TRANSPORT_TIMEOUT) {
-		con->estimatedRTT = (1-x) * con->estimatedRTT + x * sampleRTT;
-		con->deviation =    (1-y) * con->deviation    + y * abs(sampleRTT - con->estimatedRTT);
-	} else {
+	if (con->rttProbe || con->estimatedRTT == TRANSPORT_TIMEOUT) {
 		con->estimatedRTT = sampleRTT;
+		con->deviation = sampleRTT / 2;
+		con->rttProbe = false;
+	} else {
+		/* the deviation is taken against the old estimation */
+		con->deviation =    (1-y) * con->deviation    + y * llabs(sampleRTT - con->estimatedRTT);
+		con->estimatedRTT = (1-x) * con->estimatedRTT + x * sampleRTT;
 	}
+	update_timeout(con);
+	update_window_limit(con, con->bandwidth);
 	#if LOGGING == true
 		printf("%lld: [update_rtt] to_node: %d sampleRTT: %d new_estRTT: %d new_dev: %d timeout: %d\n",
 					 nodeinfo.time_in_usec, con->addr, sampleRTT, con->estimatedRTT, con->deviation, get_timeout(con));
@@ -268,6 +761,40 @@ void update_rtt(CONNECTION *con, CnetTime sampleRTT)
 }
 
 
+/**
+ * Returns the smoothed RTT of the given connection, 0 as long as no RTT
+ * was measured.
+ *
+ * @param con The connection.
+ * @return The estimated RTT or 0.
+ */
+CnetTime smoothed_rtt(CONNECTION *con)
+{
+	return con->estimatedRTT != TRANSPORT_TIMEOUT ? con->estimatedRTT : 0;
+}
+
+
+/**
+ * Returns the number of payload bytes of a connection which were sent
+ * and wait for acknowledgment.
+ *
+ * @param con The connection.
+ * @return Bytes in flight.
+ */
+size_t bytes_in_flight(CONNECTION *con)
+{
+	size_t bytes = 0;
+
+	for (int i = 0; i < con->outCount; i++) {
+		OUT_SEGMENT *outSeg = out_segment(con, i);
+		if (outSeg->inFlight && outSeg->timesSend > 0 && !outSeg->sacked) {
+			bytes += outSeg->size;
+		}
+	}
+	return bytes;
+}
+
+
 /**
  * Returns and proper timeout value for the given connection.
  * 
@@ -276,7 +803,25 @@ void update_rtt(CONNECTION *con, CnetTime sampleRTT)
  */
 CnetTime get_timeout(CONNECTION *con)
 {
-	return con->estimatedRTT + 4 * con->deviation;
+	return con->timeout;
+}
+
+
+/**
+ * (Re)starts the retransmission timer of the given connection if
+ * a segment is waiting for acknowledgment, stops it otherwise.
+ *
+ * @param con The connection.
+ */
+void restart_rto_timer(CONNECTION *con)
+{
+	if (con->rtoTimer != -1) {
+		CHECK(CNET_stop_timer(con->rtoTimer));
+		con->rtoTimer = -1;
+	}
+	if (con->outCount > 0 && out_segment(con, 0)->timesSend > 0) {
+		con->rtoTimer = CNET_start_timer(TRANSPORT_TIMER, get_timeout(con), (CnetData) con->addr);
+	}
 }
 
 
@@ -299,32 +844,75 @@ size_t distance(size_t startOffset, size_t endOffset)
 
 
 /**
- * Marshals segment for efficient transmission. 
- * Segment needs to be unmarshaled before usage.
+ * Returns the size of the sack blocks of a header.
  *
- * @param seg Marshaled segment.
- * @param header Header of the segment.
- * @param payload Payload of the segment.
- * @param size Size of the payload.
- * @return Size of the marshaled segment.
+ * @param header Header of a segment.
+ * @return Size in byte the sack blocks take in front of the payload.
  */
-size_t marshal_segment(SEGMENT *seg, segment_header *header, char *payload, size_t size)
+size_t sack_size(segment_header *header)
 {
-	/* encode isLast in offset */
-	seg->header.offset    = header->offset | (header->isLast ? MAX_SEGMENT_OFFSET : 0);
-	seg->header.ackOffset = header->ackOffset;
-
-	memcpy(seg->payload, payload, size);
-
-	return size + sizeof(seg->header);
+	#if USE_SACK == true
+	return header->numSacks * sizeof(sack_block);
+	#else
+	return 0;
+	#endif
 }
 
 
 /**
- * Unmarshals segment.
+ * Returns the size of the message ends of a header.
  *
- * @param seg Segment to unmarshal.
- * @param header Unmarshaled header.
+ * @param header Header of a segment.
+ * @return Size in byte the message ends take in front of the payload.
+ */
+size_t bounds_size(segment_header *header)
+{
+	#if USE_COALESCING == true
+	return header->numBounds * sizeof(uint16_t);
+	#else
+	return 0;
+	#endif
+}
+
+
+/**
+ * Marshals segment for efficient transmission. 
+ * Segment needs to be unmarshaled before usage.
+ * The payload must already be stored in the segment, behind the space
+ * of the sack blocks and the message ends (see sack_size(), bounds_size()).
+ *
+ * @param seg Marshaled segment.
+ * @param header Header of the segment.
+ * @param size Size of the payload.
+ * @return Size of the marshaled segment.
+ */
+size_t marshal_segment(SEGMENT *seg, segment_header *header, size_t size)
+{
+	/* encode isLast in offset */
+	seg->header.offset    = header->offset | (header->isLast ? MAX_SEGMENT_OFFSET : 0);
+	seg->header.ackOffset = header->ackOffset | (header->ecnEcho ? MAX_SEGMENT_OFFSET : 0);
+	#if USE_TIMESTAMPS == true
+	seg->header.timestamp = header->timestamp;
+	seg->header.tsEcho    = header->tsEcho;
+	#endif
+	#if USE_SACK == true
+	seg->header.ackOffset |= (uint32_t) header->numSacks << SACK_SHIFT;
+	memcpy(seg->payload, header->sacks, sack_size(header));
+	#endif
+	#if USE_COALESCING == true
+	seg->header.offset |= (uint32_t) header->numBounds << BOUNDARY_SHIFT;
+	memcpy(seg->payload + sack_size(header), header->bounds, bounds_size(header));
+	#endif
+
+	return size + sack_size(header) + bounds_size(header) + sizeof(seg->header);
+}
+
+
+/**
+ * Unmarshals segment.
+ *
+ * @param seg Segment to unmarshal.
+ * @param header Unmarshaled header.
  * @param payload Unmarshald payload.
  * @param size Size of the unmarshaled payload.
  */
@@ -332,16 +920,93 @@ size_t unmarshal_segment(SEGMENT *seg, segment_header *header, char **payload, s
 {
 	/* decode isLast from offset */
 	header->isLast    = seg->header.offset & MAX_SEGMENT_OFFSET;
-	header->offset    = seg->header.offset ^ (header->isLast ? MAX_SEGMENT_OFFSET : 0);
-	header->ackOffset = seg->header.ackOffset;
+	header->offset    = seg->header.offset & (MAX_SEGMENT_OFFSET - 1);
+	header->ecnEcho   = seg->header.ackOffset & MAX_SEGMENT_OFFSET;
+	header->ackOffset = seg->header.ackOffset & (MAX_SEGMENT_OFFSET - 1);
+	#if USE_TIMESTAMPS == true
+	header->timestamp = seg->header.timestamp;
+	header->tsEcho    = seg->header.tsEcho;
+	#endif
+	#if USE_SACK == true
+	header->numSacks  = seg->header.ackOffset >> SACK_SHIFT;
+	memcpy(header->sacks, seg->payload, sack_size(header));
+	#endif
+	#if USE_COALESCING == true
+	header->numBounds = seg->header.offset >> BOUNDARY_SHIFT;
+	memcpy(header->bounds, seg->payload + sack_size(header), bounds_size(header));
+	#endif
 
-	size_t payloadSize = size - sizeof(seg->header);
-	*payload = seg->payload;
+	size_t options = sack_size(header) + bounds_size(header);
+	size_t payloadSize = size - options - sizeof(seg->header);
+	*payload = seg->payload + options;
 
 	return payloadSize;
 }
 
 
+/**
+ * Sets the acknowledgment fields of a header for the given connection,
+ * which acknowledges all received data (a pending delayed ACK is dropped):
+ * the acknowledgment offset, a pending congestion echo (which is cleared),
+ * the timestamps and as many sack blocks as fit into 'room' bytes.
+ *
+ * @param con The connection to acknowledge data for.
+ * @param header Header of the segment to send.
+ * @param room Bytes the segment may grow by.
+ */
+void set_ack_fields(CONNECTION *con, segment_header *header, size_t room)
+{
+	con->ackPending = 0;
+	if (con->ackTimer != -1) {
+		CHECK(CNET_stop_timer(con->ackTimer));
+		con->ackTimer = -1;
+	}
+
+	header->ackOffset = buffer_next_invalid(con->inBuf, con->bufferStart);
+	header->ecnEcho   = con->ecnEcho;
+	con->ecnEcho      = false;
+	#if USE_TIMESTAMPS == true
+	header->timestamp = nodeinfo.time_in_usec;
+	header->tsEcho    = con->tsRecent;
+	#endif
+
+	#if USE_SACK == true
+	size_t starts[MAX_SACK_BLOCKS], ends[MAX_SACK_BLOCKS];
+	size_t max = room / sizeof(sack_block);
+	max = MIN(max, MAX_SACK_BLOCKS);
+
+	header->numSacks = buffer_valid_ranges(con->inBuf, header->ackOffset, RECEIVE_WINDOW, starts, ends, max);
+	for (int i = 0; i < header->numSacks; i++) {
+		header->sacks[i].start = starts[i];
+		header->sacks[i].end   = ends[i];
+	}
+	#endif
+}
+
+
+/**
+ * Reduces the window of a connection when the receiver echoed congestion.
+ * The window is reduced at most once per round trip time.
+ *
+ * @param con The connection.
+ */
+void ecn_reduce_window(CONNECTION *con)
+{
+	if (nodeinfo.time_in_usec - con->lastEcnCut < con->estimatedRTT) {
+		return;
+	}
+
+	congestion_on_ecn(con->cc);
+	con->windowSize = congestion_cwnd(con->cc);
+	con->lastEcnCut = nodeinfo.time_in_usec;
+
+	#if LOGGING == true
+	printf("%lld: [ecn_echo] to_node: %d window_size: %d\n",
+				 nodeinfo.time_in_usec, con->addr, (int) con->windowSize);
+	#endif
+}
+
+
 /**
  * Sends an empty segment over the given connection
  * in order to explicitly acknowledge received segments.
@@ -350,95 +1015,611 @@ size_t unmarshal_segment(SEGMENT *seg, segment_header *header, char **payload, s
  */
 void transmit_ack(CONNECTION *con)
 {
-	SEGMENT *seg = malloc(sizeof(marshaled_segment_header));
+	SEGMENT *seg = malloc(sizeof(marshaled_segment_header) + MAX_SACK_BLOCKS * sizeof(sack_block));
 	segment_header header;
 
-	header.offset    = con->nextOffset - 1;
-	header.ackOffset = buffer_next_invalid(con->inBuf, con->bufferStart);
+	header.offset    = (con->nextOffset + MAX_SEGMENT_OFFSET - 1) % MAX_SEGMENT_OFFSET;
 	header.isLast    = true;
+	#if USE_COALESCING == true
+	header.numBounds = 0;
+	#endif
+	set_ack_fields(con, &header, con->segmentSize);
 	#if LOGGING == true
 		printf("%lld: [send_not_piggybacked_ack] to_node: %d\n", nodeinfo.time_in_usec, con->addr);
 	#endif
 
-	size_t segSize = marshal_segment(seg, &header, NULL, 0);
-	network_transmit(con->addr, (char *)seg, segSize);
-	con->lastSendAck = nodeinfo.time_in_usec;
+	size_t segSize = marshal_segment(seg, &header, 0);
+	network_transmit(con->addr, CLASS_LATENCY, (char *)seg, segSize);
+	ackCounters.acks++;
+	ackCounters.ackBytes += segSize;
 	free(seg);
 }
 
 
 /**
- * Hands segment to network layer and starts timer.
+ * Decides when the data a connection received are acknowledged explicitly,
+ * after a segment was received. The ACK is sent at once if the segment
+ * was out of order or filled a hole, or if ACK_EVERY segments are not
+ * acknowledged yet. A due ACK is held back for ACK_HOLD_TIME if the pacer
+ * sends a segment, which piggybacks it, by then.
+ * Otherwise the delayed ACK timer is started.
  *
- * @param outSeg Segment to hand over to network layer.
+ * @param con The connection.
+ * @param immediate The segment was out of order or filled a hole.
  */
-void transmit_segment(OUT_SEGMENT *outSeg)
+void schedule_ack(CONNECTION *con, bool immediate)
 {
-	CONNECTION *con = get_connection(outSeg->addr);
+	if (con->ackPending == 0) {
+		return; // piggybacked already
+	}
+
+	if (immediate || con->ackPending >= ACK_EVERY) {
+		bool piggyback = con->paced && con->nextSendTime - nodeinfo.time_in_usec < ACK_HOLD_TIME;
 
-	/* Congestion control */
-	if (outSeg->timesSend > 1 && con->windowSize > 1) {
-		con->threshold = con->windowSize / 2;
-		con->windowSize = 1;
+		if (immediate || !piggyback) {
+			transmit_ack(con);
+			return;
+		}
+		if (con->ackTimer != -1) {
+			CHECK(CNET_stop_timer(con->ackTimer));
+		}
+		con->ackTimer = CNET_start_timer(ACK_TIMER, ACK_HOLD_TIME, (CnetData) con->addr);
+	} else if (con->ackTimer == -1) {
+		con->ackTimer = CNET_start_timer(ACK_TIMER, DELAYED_ACK_TIME, (CnetData) con->addr);
 	}
-	
-	OUT_SEGMENT *winSeg = vector_peek(con->outSegments, con->windowSize, NULL);
+}
+
+
+/**
+ * Handles the expiry of the delayed ACK timer of the connection to 'addr':
+ * the received data are acknowledged explicitly.
+ *
+ * @param addr Address of the connection whose timer expired.
+ */
+void transport_ack_timeout(CnetAddr addr)
+{
+	CONNECTION *con = addrmap_find(connections, addr);
+
+	if (con == NULL) {
+		return;
+	}
+	con->ackTimer = -1;
+	if (con->ackPending > 0) {
+		transmit_ack(con);
+	}
+}
+
+
+/**
+ * Hands segment to network layer and starts the retransmission timer
+ * if it is not running. Segments which fell out of the window are
+ * put back into the queue.
+ * The header is marshaled, the payload is taken from the send buffer.
+ *
+ * @param con The connection of the segment.
+ * @param id Id of the out segment to hand over to network layer.
+ */
+void transmit_segment(CONNECTION *con, uint16_t id)
+{
+	OUT_SEGMENT *outSeg = out_segment_by_id(con, id);
+	OUT_SEGMENT *winSeg = out_segment(con, con->windowSize);
 
 	if (winSeg == NULL || acknowledged(outSeg->offset, winSeg->offset)) {
 		#if LOGGING == true
-		printf("%lld: [transmit_segment] to_node: %d threshold: %d \
+		printf("%lld: [transmit_segment] to_node: %d \
 						window_size: %d numOutSeg: %d numSentSegments %d\n",
-						nodeinfo.time_in_usec, outSeg->addr, con->threshold,
-						con->windowSize, vector_nitems(con->outSegments), con->numSentSegments);
+						nodeinfo.time_in_usec, con->addr,
+						con->windowSize, con->outCount, con->numSentSegments);
 		#endif
 
+		SMALL_SEGMENT seg;
+		segment_header header;
+		header.offset    = outSeg->offset;
+		header.isLast    = outSeg->isLast;
+		#if USE_COALESCING == true
+		header.numBounds = outSeg->numBounds;
+		memcpy(header.bounds, outSeg->bounds, bounds_size(&header));
+		#endif
+		if (con->ackPending > 0) {
+			ackCounters.piggybacked++;
+		}
+		size_t used = outSeg->size + bounds_size(&header);
+		set_ack_fields(con, &header, used < con->segmentSize ? con->segmentSize - used : 0);
+
+		send_buffer_load(con, outSeg->offset, seg.payload + sack_size(&header) + bounds_size(&header), outSeg->size);
+		size_t segSize = marshal_segment((SEGMENT *) &seg, &header, outSeg->size);
+
 		outSeg->timesSend++;
-		outSeg->seg->header.ackOffset = buffer_next_invalid(con->inBuf, con->bufferStart);
-		network_transmit(outSeg->addr, (char *)outSeg->seg, outSeg->size);
-		CnetTime timeout = outSeg->timesSend * get_timeout(con);
-		outSeg->timerId = CNET_start_timer(TRANSPORT_TIMER, timeout, (CnetData) outSeg);
-		con->lastSendAck = nodeinfo.time_in_usec;
+		outSeg->sendTime = nodeinfo.time_in_usec;
+		network_transmit(con->addr, con->tclass, (char *) &seg, segSize);
+		if (con->rtoTimer == -1) {
+			con->rtoTimer = CNET_start_timer(TRANSPORT_TIMER, get_timeout(con), (CnetData) con->addr);
+		}
 	} else {
-		outSeg->timerId = -1;
+		outSeg->inFlight = false;
 		con->numSentSegments--;
 	}
 }
 
 
+/**
+ * Retransmits the first unacknowledged segment of a connection at once,
+ * also if it is still queued or fell out of the window.
+ *
+ * @param con The connection.
+ */
+void retransmit_first_segment(CONNECTION *con)
+{
+	OUT_SEGMENT *outSeg = out_segment(con, 0);
+
+	if (!outSeg->inFlight) {
+		outSeg->inFlight = true;
+		con->numSentSegments++;
+	}
+	outSeg->sackResent = true;
+	transmit_segment(con, con->outFirst);
+}
+
+
+#if USE_SACK == true
+/**
+ * Marks the out segments of a connection which the sack blocks
+ * of a received header report as received.
+ * Marked segments are neither counted in flight nor sent again.
+ *
+ * @param con The connection.
+ * @param header Received header with sack blocks.
+ */
+void update_scoreboard(CONNECTION *con, segment_header *header)
+{
+	if (con->outCount == 0) {
+		return;
+	}
+	size_t base = out_segment(con, 0)->offset;
+
+	for (int b = 0; b < header->numSacks; b++) {
+		size_t start = (header->sacks[b].start + MAX_SEGMENT_OFFSET - base) % MAX_SEGMENT_OFFSET;
+		size_t end   = (header->sacks[b].end   + MAX_SEGMENT_OFFSET - base) % MAX_SEGMENT_OFFSET;
+
+		for (int i = 0; i < con->outCount; i++) {
+			OUT_SEGMENT *outSeg = out_segment(con, i);
+			size_t offset = (outSeg->offset + MAX_SEGMENT_OFFSET - base) % MAX_SEGMENT_OFFSET;
+
+			if (outSeg->timesSend == 0 || offset >= end) {
+				break;
+			}
+			if (!outSeg->sacked && offset >= start && offset + outSeg->size <= end) {
+				outSeg->sacked = true;
+				if (!outSeg->inFlight) {
+					outSeg->inFlight = true;
+					con->numSentSegments++;
+				}
+			}
+		}
+	}
+}
+
+
+/**
+ * Resends the out segments of a connection which are considered lost:
+ * at least DUPACK_THRESHOLD later segments were reported received
+ * (DupThresh of RFC 6675), but the segment was not.
+ * Every segment is resent once per loss, the timeout handles further losses.
+ * The first loss of a window enters fast recovery.
+ *
+ * @param con The connection.
+ */
+void retransmit_lost_segments(CONNECTION *con)
+{
+	int sacked = 0;
+	for (int i = 0; i < con->outCount; i++) {
+		sacked += out_segment(con, i)->sacked;
+	}
+
+	for (int i = 0; i < con->outCount && sacked >= DUPACK_THRESHOLD; i++) {
+		OUT_SEGMENT *outSeg = out_segment(con, i);
+
+		if (outSeg->sacked) {
+			sacked--;
+		} else if (outSeg->inFlight && outSeg->timesSend > 0 && !outSeg->sackResent) {
+			if (con->ackCounter < DUPACK_THRESHOLD) {
+				con->ackCounter = DUPACK_THRESHOLD;
+				congestion_on_dupack(con->cc, DUPACK_THRESHOLD, bytes_in_flight(con));
+				con->windowSize = congestion_cwnd(con->cc);
+			}
+			#if LOGGING == true
+			printf("%lld: [sack_retransmit] to_node: %d offset: %d\n",
+						 nodeinfo.time_in_usec, con->addr, (int) outSeg->offset);
+			#endif
+			outSeg->sackResent = true;
+			transmit_segment(con, con->outFirst + i);
+		}
+	}
+}
+#endif
+
+
+/**
+ * Returns the index of the first out segment of a connection which is
+ * inside the window and neither sent nor acknowledged, -1 if there is none.
+ *
+ * @param con The connection.
+ * @return Index of the next segment to send or -1.
+ */
+int next_queued_segment(CONNECTION *con)
+{
+	for (int i = 0; i < con->windowSize && i < con->outCount; i++) {
+		OUT_SEGMENT *outSeg = out_segment(con, i);
+		if (!outSeg->inFlight) {
+			return outSeg->held ? -1 : i;
+		}
+	}
+	return -1;
+}
+
+
+/**
+ * Returns the time in usec the pacer waits after sending 'size' bytes over
+ * the given connection: the transmission time on the bottleneck of the
+ * route, or longer if the pacing rate of the congestion control requires it.
+ *
+ * @param con The connection.
+ * @param size Size of the sent payload.
+ * @return Time before the next segment may be sent.
+ */
+CnetTime pacing_interval(CONNECTION *con, size_t size)
+{
+	CnetTime interval = 0;
+
+	if (con->bandwidth > 0) {
+		interval = 8000000LL * size / con->bandwidth;
+	}
+	double rate = congestion_pacing_rate(con->cc, smoothed_rtt(con));
+	if (rate > 0) {
+		CnetTime rateInterval = size / rate;
+		interval = MAX(interval, rateInterval);
+	}
+	return interval;
+}
+
+
+/**
+ * Appends a connection to the ring of the pacer.
+ *
+ * @param con The connection.
+ */
+void pacer_push(CONNECTION *con)
+{
+	if (pacer.count == pacer.capacity) {
+		int capacity = pacer.capacity > 0 ? 2 * pacer.capacity : 8;
+		CnetAddr *addrs = malloc(capacity * sizeof(*addrs));
+
+		for (int i = 0; i < pacer.count; i++) {
+			addrs[i] = pacer.addrs[(pacer.first + i) & (pacer.capacity - 1)];
+		}
+		free(pacer.addrs);
+		pacer.addrs = addrs;
+		pacer.capacity = capacity;
+		pacer.first = 0;
+	}
+
+	pacer.addrs[(pacer.first + pacer.count) & (pacer.capacity - 1)] = con->addr;
+	pacer.count++;
+	con->paced = true;
+}
+
+
+/**
+ * Removes the first connection from the ring of the pacer.
+ *
+ * @return Address of the connection.
+ */
+CnetAddr pacer_pop()
+{
+	CnetAddr addr = pacer.addrs[pacer.first];
+
+	pacer.first = (pacer.first + 1) & (pacer.capacity - 1);
+	pacer.count--;
+	return addr;
+}
+
+
+/**
+ * Makes sure the pacing timer expires at time 'time' at the latest.
+ *
+ * @param time Time the pacer has to run.
+ */
+void pacer_schedule(CnetTime time)
+{
+	if (pacer.timer != -1) {
+		if (pacer.time <= time) {
+			return;
+		}
+		CHECK(CNET_stop_timer(pacer.timer));
+	}
+
+	pacer.time  = MAX(time, nodeinfo.time_in_usec + 1);
+	pacer.timer = CNET_start_timer(PACING_TIMER, pacer.time - nodeinfo.time_in_usec, 0);
+}
+
+
+/**
+ * Sends the queued segments whose time has come.
+ *
+ * Connections are served in deficit round robin order: per visit a
+ * connection may send PACING_QUANTUM bytes, as long as its pacing interval
+ * passed. Connections whose first link queues more than MAX_QUEUE_DELAY
+ * wait until the queue drained. Connections without queued segments leave
+ * the ring. Finally the timer is set for the connection which may send next.
+ */
+void pacer_run()
+{
+	CnetTime now    = nodeinfo.time_in_usec;
+	CnetTime wakeup = -1;
+	int waiting     = 0; // connections visited in a row which had to wait
+
+	while (waiting < pacer.count) {
+		CnetAddr addr = pacer_pop();
+		CONNECTION *con = addrmap_find(connections, addr);
+		int i = next_queued_segment(con);
+
+		if (i < 0) {
+			con->paced = false;
+			con->deficit = 0;
+			continue;
+		}
+
+		/* backpressure from the link layer */
+		CnetTime queueDelay = network_get_queue_delay(addr, con->tclass);
+		if (queueDelay > MAX_QUEUE_DELAY) {
+			con->nextSendTime = MAX(con->nextSendTime, now + queueDelay - MAX_QUEUE_DELAY);
+		}
+
+		if (con->nextSendTime > now) {
+			if (wakeup == -1 || con->nextSendTime < wakeup) {
+				wakeup = con->nextSendTime;
+			}
+			pacer_push(con);
+			waiting++;
+			continue;
+		}
+
+		con->deficit += PACING_QUANTUM;
+		while (i >= 0 && con->nextSendTime <= now && out_segment(con, i)->size <= con->deficit) {
+			OUT_SEGMENT *outSeg = out_segment(con, i);
+			CnetTime start = MAX(con->nextSendTime, now);
+
+			outSeg->inFlight = true;
+			con->numSentSegments++;
+			con->deficit -= outSeg->size;
+			con->nextSendTime = start + pacing_interval(con, outSeg->size);
+			transmit_segment(con, con->outFirst + i);
+			i = next_queued_segment(con);
+		}
+
+		if (i < 0) {
+			con->paced = false;
+			con->deficit = 0;
+		} else {
+			pacer_push(con);
+		}
+		waiting = 0;
+	}
+
+	if (wakeup != -1) {
+		pacer_schedule(wakeup);
+	}
+}
+
+
+/**
+ * Handles the pacing timer: the next queued segments may be sent.
+ */
+void transport_pacing_timeout()
+{
+	pacer.timer = -1;
+	pacer_run();
+}
+
+
+/**
+ * Handles the retransmission timer of the connection to 'addr'.
+ *
+ * The first unacknowledged segment is resent, the timeout is doubled
+ * (up to MAX_TRANSPORT_TIMEOUT) and the window falls back to slow start.
+ * All other unacknowledged segments are queued again.
+ *
+ * @param addr Address of the connection whose timer expired.
+ */
+void transport_rto_timeout(CnetAddr addr)
+{
+	CONNECTION *con = addrmap_find(connections, addr);
+
+	if (con == NULL) {
+		return;
+	}
+	con->rtoTimer = -1;
+	if (con->outCount == 0) {
+		return;
+	}
+
+	congestion_on_timeout(con->cc);
+	con->windowSize = congestion_cwnd(con->cc);
+
+	con->timeout = 2 * con->timeout;
+	con->timeout = MIN(con->timeout, MAX_TRANSPORT_TIMEOUT);
+
+	#if LOGGING == true
+	printf("%lld: [rto_timeout] to_node: %d window_size: %d timeout: %lld\n",
+				 nodeinfo.time_in_usec, con->addr, (int) con->windowSize, con->timeout);
+	#endif
+
+	/* go back: the following segments are resent as the window grows again,
+	   except those the receiver reported */
+	con->numSentSegments = 0;
+	for (int i = 0; i < con->outCount; i++) {
+		OUT_SEGMENT *outSeg = out_segment(con, i);
+		outSeg->inFlight   = outSeg->sacked;
+		outSeg->sackResent = false;
+		con->numSentSegments += outSeg->sacked;
+	}
+
+	retransmit_first_segment(con);
+}
+
+
 /**
  * Transmits segments to address 'addr'
  * if window is not saturated and segments are available.
+ * With pacing the connection joins the pacer, which sends
+ * the segments whose time has come at once.
  *
  * @param addr Address to transmit segments to.
  */
 void transmit_segments(CnetAddr addr)
 {
 	CONNECTION *con = get_connection(addr);
-	int timeout = 1;
+
+	if (USE_PACING) {
+		if (!con->paced && next_queued_segment(con) >= 0) {
+			pacer_push(con);
+		}
+		if (con->paced && con->nextSendTime <= nodeinfo.time_in_usec) {
+			pacer_run();
+		} else if (con->paced) {
+			pacer_schedule(con->nextSendTime);
+		}
+		return;
+	}
 
 	/* window not saturated and segments available */
-	for (int i = 0; i < con->windowSize && i < vector_nitems(con->outSegments); i++) {
-		OUT_SEGMENT *outSeg = vector_peek(con->outSegments, i, NULL);
-		if (outSeg->timerId == -1) {
-			if (USE_GEARING) {
-				outSeg->timerId = CNET_start_timer(GEARING_TIMER, timeout, (CnetData) outSeg);
-			} else {
-				transmit_segment(outSeg);
-			}
+	for (int i = 0; i < con->windowSize && i < con->outCount; i++) {
+		OUT_SEGMENT *outSeg = out_segment(con, i);
+		if (outSeg->held) {
+			break;
+		}
+		if (!outSeg->inFlight) {
+			outSeg->inFlight = true;
 			con->numSentSegments++;
-			outSeg->sendTime = nodeinfo.time_in_usec;
-			timeout += 500;
+			transmit_segment(con, con->outFirst + i);
 		}
 	}
 }
 
 
+#if USE_COALESCING == true
+/**
+ * Checks whether a message can be appended to the last out segment of a
+ * connection: the segment was not sent yet and has room for the message
+ * and its end. All data of a connection share its traffic class.
+ *
+ * @param con The connection.
+ * @param size Size of the message.
+ * @return Whether the message fits into the last out segment.
+ */
+bool coalesce_room(CONNECTION *con, size_t size)
+{
+	if (con->outCount == 0) {
+		return false;
+	}
+	OUT_SEGMENT *last = out_segment(con, con->outCount - 1);
+
+	return !last->inFlight && last->timesSend == 0 && last->numBounds < MAX_SEGMENT_BOUNDARIES &&
+			last->size + size + (last->numBounds + 1) * sizeof(uint16_t) <= con->segmentSize;
+}
+
+
+/**
+ * Appends a message to the last out segment of a connection, if it has
+ * room for it (see coalesce_room()).
+ * The message must already be in the send buffer.
+ *
+ * @param con The connection.
+ * @param size Size of the message.
+ * @return Whether the message was appended.
+ */
+bool coalesce_message(CONNECTION *con, size_t size)
+{
+	if (!coalesce_room(con, size)) {
+		return false;
+	}
+	OUT_SEGMENT *last = out_segment(con, con->outCount - 1);
+
+	last->bounds[last->numBounds++] = last->size;
+	last->size += size;
+	return true;
+}
+
+
+/**
+ * Holds the last out segment of a connection back, if it is not full and
+ * sent segments wait for acknowledgment, so that following messages can
+ * be appended. The coalesce timer limits the delay.
+ *
+ * @param con The connection.
+ */
+void hold_last_segment(CONNECTION *con)
+{
+	OUT_SEGMENT *last = out_segment(con, con->outCount - 1);
+
+	if (con->numSentSegments == 0 || last->inFlight || last->size >= con->segmentSize) {
+		return;
+	}
+
+	last->held = true;
+	if (con->coalesceTimer == -1) {
+		con->coalesceTimer = CNET_start_timer(COALESCE_TIMER, COALESCE_TIME, (CnetData) con->addr);
+	}
+}
+
+
+/**
+ * Releases the held out segment of a connection, if there is one.
+ *
+ * @param con The connection.
+ */
+void release_held_segment(CONNECTION *con)
+{
+	if (con->coalesceTimer != -1) {
+		CHECK(CNET_stop_timer(con->coalesceTimer));
+		con->coalesceTimer = -1;
+	}
+	if (con->outCount > 0) {
+		out_segment(con, con->outCount - 1)->held = false;
+	}
+}
+
+
+/**
+ * Handles the expiry of the coalesce timer of the connection to 'addr':
+ * the held segment is released and sent.
+ *
+ * @param addr Address of the connection whose timer expired.
+ */
+void transport_coalesce_timeout(CnetAddr addr)
+{
+	CONNECTION *con = addrmap_find(connections, addr);
+
+	if (con == NULL) {
+		return;
+	}
+	con->coalesceTimer = -1;
+	release_held_segment(con);
+	transmit_segments(addr);
+}
+#endif
+
+
 /**
  * Transmits a message.
  *
  * A new connection is created if it is the first to send to or receive from
- * 'addr'. If necessary the message is split into several parts (size is given
- * by SEGMENT_SIZE) which are added to the outgoing queue.
+ * 'addr'. The message is copied to the send buffer and split into several
+ * parts (size is given by the path MTU, at most SEGMENT_SIZE) which are added
+ * to the outgoing queue.
+ * All data of a connection take one route, so they arrive in order: a
+ * short message starting the data of an idle connection selects the
+ * fastest route, a long one the bulk route.
  * Finally it triggers the sending of segments.
  *
  * @param addr Address to send the message to.
@@ -447,43 +1628,58 @@ void transmit_segments(CnetAddr addr)
  */
 void transport_transmit(CnetAddr addr, char *data, size_t size)
 {
+	compact_idle_connections();
+
 	CONNECTION *con = get_connection(addr);
-	update_window_limit(con);
+	con->lastActivity = nodeinfo.time_in_usec;
+	if (con->outCount == 0) {
+		con->tclass = size <= LATENCY_MESSAGE_SIZE ? CLASS_LATENCY : CLASS_BULK;
+	}
+	update_window_limit(con, network_get_bandwidth(addr, con->tclass));
+	update_segment_size(con, network_get_mtu(addr, con->tclass));
+
+	send_buffer_store(con, con->nextOffset, data, size);
 
+	/* append small messages to a segment which was not sent yet */
 	size_t remainingBytes = size;
-	size_t processedBytes = 0;
+	#if USE_COALESCING == true
+	if (coalesce_message(con, size)) {
+		con->nextOffset = (con->nextOffset + size) % MAX_SEGMENT_OFFSET;
+		remainingBytes  = 0;
+	} else {
+		release_held_segment(con);
+	}
+	#endif
 
 	/* split message into several segments */
-	for (int i = 0; remainingBytes > 0; i++) {
-		SEGMENT *seg = malloc(sizeof(*seg));
-		segment_header header;
-
-		assert(remainingBytes + processedBytes == size);
-		size_t payloadSize = MIN(remainingBytes, SEGMENT_SIZE);
-		header.offset    = con->nextOffset;
-		header.ackOffset = buffer_next_invalid(con->inBuf, con->bufferStart);
-		header.isLast    = remainingBytes == payloadSize;
-
-		size_t segSize = marshal_segment(seg, &header, data + processedBytes, payloadSize);
+	while (remainingBytes > 0) {
+		OUT_SEGMENT *outSeg = append_out_segment(con);
+		size_t payloadSize = MIN(remainingBytes, con->segmentSize);
+
+		outSeg->size = payloadSize;
+		outSeg->isLast = remainingBytes == payloadSize;
+		outSeg->timesSend = 0;
+		outSeg->inFlight = false;
+		outSeg->sacked = false;
+		outSeg->sackResent = false;
+		outSeg->offset = con->nextOffset;
+		outSeg->held = false;
+		outSeg->numBounds = 0;
 
 		remainingBytes -= payloadSize;
-		processedBytes += payloadSize;
 		con->nextOffset  = (con->nextOffset + payloadSize) % MAX_SEGMENT_OFFSET;
-
-		OUT_SEGMENT outSeg;
-		outSeg.addr = addr;
-		outSeg.seg = seg;
-		outSeg.size = segSize;
-		outSeg.timesSend = 0;
-		outSeg.timerId = -1;
-		outSeg.offset = header.offset;
-
-		/* add created segment to vector of sendable segments */
-		vector_append(con->outSegments, &outSeg, sizeof(outSeg));
 	}
+	#if USE_COALESCING == true
+	hold_last_segment(con);
+	#endif
 
 	/* stop the application if list of outsegments exceeds threshold */
-	if (vector_nitems(con->outSegments) >= con->windowSize) {
+	bool saturated = con->outCount >= con->windowSize;
+	#if USE_COALESCING == true
+	/* at a full window, as long as small messages can be appended to the last segment */
+	saturated = con->outCount > con->windowSize || (saturated && !coalesce_room(con, 1));
+	#endif
+	if (saturated) {
 		#if LOGGING == true
 			printf("%lld: [disable_application_window_saturated] to_node: %d\n", nodeinfo.time_in_usec, addr);
 		#endif
@@ -507,144 +1703,252 @@ void transport_transmit(CnetAddr addr, char *data, size_t size)
  * @param addr Source address.
  * @param data Data to receive.
  * @param size Size of the data to receive.
+ * @param congested The network layer experienced congestion on the way.
  */
-void transport_receive(CnetAddr addr, char *data, size_t size)
+void transport_receive(CnetAddr addr, char *data, size_t size, bool congested)
 {
+	compact_idle_connections();
+
 	CONNECTION *con = get_connection(addr);
 
 	#if LOGGING == true
-	printf("%lld: [receive_segment] from_node: %d threshold: %d \
+	printf("%lld: [receive_segment] from_node: %d \
 					window_size: %d numOutSeg: %d numSentSegments: %d\n",
-					nodeinfo.time_in_usec, addr, con->threshold, con->windowSize,
-					vector_nitems(con->outSegments), con->numSentSegments);
+					nodeinfo.time_in_usec, addr, con->windowSize,
+					con->outCount, con->numSentSegments);
 	#endif
 
 	SEGMENT *segment = (SEGMENT *)data;
 	segment_header header;
 	char *payload;
 
-	int numSentSegments = con->numSentSegments;
 	size_t payloadSize = unmarshal_segment(segment, &header, &payload, size);
 	size_t ackOffset   = buffer_next_invalid(con->inBuf, con->bufferStart); //the offset the node is waiting for
 
-	/* congestion control ala Reno */
-#if USE_RENO == true
+	/* explicit congestion notification */
+	if (congested && payloadSize > 0) {
+		con->ecnEcho = true;
+	}
+	if (header.ecnEcho) {
+		ecn_reduce_window(con);
+	}
+
+	/* duplicated ACKs, only non piggybacked ones count,
+	   ACKs overtaken by later ones on another route are stale */
 	if(header.ackOffset == con->lastAckOffset) {
-		if(payloadSize == 0){ // only increase if a non piggybacked ACK is received
+		if(payloadSize == 0 && con->outCount > 0 && out_segment(con, 0)->timesSend > 0) {
 			con->ackCounter++;
+			if (congestion_on_dupack(con->cc, con->ackCounter, bytes_in_flight(con))) {
+				#if LOGGING == true
+				printf("%lld: [fast_retransmit] to_node: %d window_size: %d numOutSeg: %d\n",
+							 nodeinfo.time_in_usec, con->addr, (int) congestion_cwnd(con->cc), con->outCount);
+				#endif
+				retransmit_first_segment(con);
+			}
+			con->windowSize = congestion_cwnd(con->cc);
 		}
-	} else {
+	} else if (acknowledged(con->lastAckOffset, header.ackOffset)) {
 		con->ackCounter = 0;
 		con->lastAckOffset = header.ackOffset;
 	}
 
-	/* calculate if fast recovery phase should be started */
-	if (con->ackCounter > 3 && payloadSize != 0) {
-		con->ackCounter = 0;
-		if(con->windowSize > 1) {
-			con->threshold  = con->windowSize / 2;
-			con->windowSize = con->threshold;
-		}
-		#if LOGGING == true
-		printf("%lld: [Reno_3_dup_ack] to_node: %d threshold: %d window_size: %d numOutSeg: %d\n",
-					 nodeinfo.time_in_usec, con->addr, con->threshold, con->windowSize, vector_nitems(con->outSegments));
-		#endif
+	#if USE_TIMESTAMPS == true
+	/* echo the timestamp of the segment which advances the acknowledgment */
+	if (payloadSize > 0 && acknowledged(header.offset, ackOffset)) {
+		con->tsRecent = header.timestamp;
+	}
+	#endif
 
-		/* perform fast retransmit */
-		if(vector_nitems(con->outSegments) > 0) {
-			size_t segmentSize;
-			OUT_SEGMENT *outSeg = vector_peek(con->outSegments, 0, &segmentSize);
-			if(outSeg->timerId != -1){
-				CHECK(CNET_stop_timer(outSeg->timerId));
-			}
-			transmit_segment(outSeg);
-		}
+	#if EXPLICIT_ACK == true
+	/* segments beyond a hole or filling one are acknowledged at once,
+	   the acknowledged offset is taken before the segment is stored */
+	bool inOrder = header.offset == ackOffset;
+	#endif
+	if (payloadSize > 0) {
+		ackCounters.segments++;
+		con->ackPending++;
+		con->lastActivity = nodeinfo.time_in_usec;
 	}
-#endif
 
-	/* ignore duplicated segments */
+	/* ignore duplicated segments, overlapping ones only add missing bytes,
+	   segments beyond the receive window are dropped */
+	size_t receiveEnd = (header.offset + payloadSize) % MAX_SEGMENT_OFFSET;
 	if (!acknowledged(header.offset + payloadSize, ackOffset) &&
-			!buffer_check(con->inBuf, header.offset) && payloadSize > 0)
+			!buffer_check_range(con->inBuf, header.offset, payloadSize) && payloadSize > 0 &&
+			distance(con->bufferStart, receiveEnd) <= RECEIVE_WINDOW)
 	{
 		/* accumulate segments in buffer */
 		buffer_store(con->inBuf, header.offset, payload, payloadSize);
 
 		if (header.isLast) { //store endOffset if segment is the last one
 			size_t endOffset = (header.offset + payloadSize) % MAX_SEGMENT_OFFSET;
-			dring_insert(con->lasts, endOffset);
+			boundary_insert(con->lasts, endOffset);
+		}
+		#if USE_COALESCING == true
+		for (int i = 0; i < header.numBounds; i++) {
+			boundary_insert(con->lasts, (header.offset + header.bounds[i]) % MAX_SEGMENT_OFFSET);
 		}
+		#endif
 
 		/* check if buffer contains complete messages -> forward to application */
 		ackOffset       = buffer_next_invalid(con->inBuf, con->bufferStart);
-		size_t nextLast = dring_peek(con->lasts);
+		size_t nextLast = boundary_peek(con->lasts);
 
 		while (nextLast != -1 && acknowledged(nextLast, ackOffset)) {
-			dring_pop(con->lasts);
+			boundary_pop(con->lasts);
 			char msg[MAX_MESSAGE_SIZE];
 			size_t msgSize = distance(con->bufferStart, nextLast);
 			buffer_load(con->inBuf, con->bufferStart, msg, msgSize);
 			CHECK(CNET_write_application(msg, &msgSize));
 
 			con->bufferStart = nextLast;
-			nextLast = dring_peek(con->lasts);
+			nextLast = boundary_peek(con->lasts);
 		}
 	}
 
-	/* process acknowledgment */
-	if(vector_nitems(con->outSegments) > 0) {
-		OUT_SEGMENT *outSeg = vector_peek(con->outSegments, 0, NULL);
+	/* process acknowledgment, stale ones do not reach the first out segment */
+	if(con->outCount > 0 && acknowledged(out_segment(con, 0)->offset, header.ackOffset)) {
+		OUT_SEGMENT *outSeg = out_segment(con, 0);
+
+		size_t endOffset = (outSeg->offset + outSeg->size) % MAX_SEGMENT_OFFSET;
 
-		SEGMENT *seg = outSeg->seg;
-		size_t endOffset = outSeg->offset + (outSeg->size - sizeof(seg->header));
-		endOffset %= MAX_SEGMENT_OFFSET;
-		assert(acknowledged(outSeg->offset, header.ackOffset));
+		size_t ackedBytes = 0;
+		CnetTime sampleRTT = 0;
 
-		/* Remove all acknowledged segments from output buffer */
+		/* Remove all acknowledged segments from output buffer, this frees their data */
 		while (acknowledged(endOffset, header.ackOffset)) {
-			outSeg = vector_remove(con->outSegments, 0, NULL);
-			CnetTime sampleRTT = nodeinfo.time_in_usec - outSeg->sendTime;
-			update_rtt(con, sampleRTT);
-			if (outSeg->timerId != -1) {
-				CHECK(CNET_stop_timer(outSeg->timerId));
+			/* Karn's rule: the ACK may belong to any of the transmissions */
+			if (!USE_TIMESTAMPS && outSeg->timesSend == 1) {
+				sampleRTT = nodeinfo.time_in_usec - outSeg->sendTime;
+				update_rtt(con, sampleRTT);
+			}
+			ackedBytes += outSeg->size;
+			if (outSeg->inFlight) {
 				con->numSentSegments--;
 			}
-			free(outSeg->seg);
-			free(outSeg);
-
-			if(vector_nitems(con->outSegments) == 0) break; // no more elements available
-
-			outSeg = vector_peek(con->outSegments, 0, NULL);
-			seg = outSeg->seg;
-			endOffset  = outSeg->offset + (outSeg->size - sizeof(seg->header));
-			endOffset %= MAX_SEGMENT_OFFSET;
-
-			/* Congestion control */
-			if (con->windowSize < con->threshold) { // slow start
-				con->windowSize = MIN(2 * con->windowSize, con->windowLimit);
-			} 
-			else if (con->windowSize < con->windowLimit) { // congestion avoidance
-				con->windowSize++;
+			con->outFirst++;
+			con->outCount--;
+
+			if(con->outCount == 0) break; // no more elements available
+
+			outSeg = out_segment(con, 0);
+			endOffset = (outSeg->offset + outSeg->size) % MAX_SEGMENT_OFFSET;
+		}
+
+		#if USE_SACK == true
+		if (header.numSacks > 0) {
+			update_scoreboard(con, &header);
+		}
+		#endif
+
+		if (ackedBytes > 0) {
+			#if USE_TIMESTAMPS == true
+			if (header.tsEcho != 0) {
+				sampleRTT = (uint32_t) nodeinfo.time_in_usec - header.tsEcho;
+				update_rtt(con, sampleRTT);
 			}
+			#endif
+			restart_rto_timer(con);
+
+			/* Congestion control, a partial ACK may reveal the next loss,
+			   unless the SACK recovery resent that segment already */
+			if (congestion_on_ack(con->cc, ackedBytes, bytes_in_flight(con), sampleRTT, smoothed_rtt(con))
+			    && con->outCount > 0 && !out_segment(con, 0)->sackResent) {
+				retransmit_first_segment(con);
+			}
+			con->windowSize = congestion_cwnd(con->cc);
 		}
-		numSentSegments = con->numSentSegments;
+		#if USE_SACK == true
+		retransmit_lost_segments(con);
+		#endif
 
-		if (vector_nitems(con->outSegments) < con->windowSize) {
+		if (con->outCount < con->windowSize) {
 			#if LOGGING == true
 			printf("%lld: [enable_application_window_unsaturated] to_node: %d\n", nodeinfo.time_in_usec, addr);
 			#endif
 			CNET_enable_application(addr);
 		}
 
+		#if USE_COALESCING == true
+		/* nothing to wait for any more, send the held segment */
+		if (con->numSentSegments == 0) {
+			release_held_segment(con);
+		}
+		#endif
 		transmit_segments(addr);
 	}
 
 	#if EXPLICIT_ACK == true
-	/* In case piggybacking ACK is not possible, send it directly */
-	if (payloadSize != 0 && numSentSegments == con->numSentSegments && 
-			nodeinfo.time_in_usec - con->lastSendAck > ACK_TIME)
-	{
-		transmit_ack(con);
+	/* In case piggybacking the ACK was not possible, send it directly or later */
+	if (payloadSize > 0) {
+		size_t start, end;
+		size_t segmentEnd = (header.offset + payloadSize) % MAX_SEGMENT_OFFSET;
+		ackOffset = buffer_next_invalid(con->inBuf, con->bufferStart);
+		bool holes = buffer_valid_ranges(con->inBuf, ackOffset, RECEIVE_WINDOW, &start, &end, 1) > 0;
+
+		schedule_ack(con, !inOrder || holes || ackOffset != segmentEnd);
+	}
+	#endif
+}
+
+
+/**
+ * Receive multicast data.
+ *
+ * Multicast data are delivered unreliably by the network layer. The transport
+ * layer does not implement multicast, thus the data are dropped and never
+ * reach the application: cnet only accepts the messages its application
+ * layer generated for this node. Multicast is evaluated by the link bytes
+ * it saves (see benchmark.sh).
+ *
+ * @param addr Source address.
+ * @param group Group address.
+ * @param data Received data.
+ * @param size Size of the received data.
+ */
+void transport_receive_multicast(CnetAddr addr, CnetAddr group, char *data, size_t size)
+{
+	#if LOGGING == true
+	printf("%lld: [receive_multicast] from_node: %d group: %d size: %d\n",
+				 nodeinfo.time_in_usec, addr, group, (int) size);
+	#endif
+}
+
+
+/**
+ * Adapts the connection to 'addr', if any, to a new route.
+ *
+ * The RTT estimation restarts with the next sample. Until then the
+ * deviation is widened, so segments on a slower route do not time out.
+ * The window limit and the segment size are recomputed from the route
+ * of the connection's traffic class, and the congestion control adapts
+ * to it; with the window based algorithms slow start may grow the window
+ * up to the new limit.
+ *
+ * @param addr Address of the destination whose route changed.
+ */
+void transport_route_changed(CnetAddr addr)
+{
+	CONNECTION *con = addrmap_find(connections, addr);
+
+	if (con == NULL) {
+		return;
 	}
+	int bandwidth = network_get_bandwidth(addr, con->tclass);
+	int mtu       = network_get_mtu(addr, con->tclass);
+
+	con->rttProbe = true;
+	con->deviation = MAX(con->deviation, con->estimatedRTT);
+	update_timeout(con);
+
+	update_window_limit(con, bandwidth);
+	update_segment_size(con, mtu);
+	congestion_route_changed(con->cc);
+	con->windowSize = congestion_cwnd(con->cc);
+
+	#if LOGGING == true
+	printf("%lld: [route_changed] to_node: %d bandwidth: %d mtu: %d window_limit: %d\n",
+				 nodeinfo.time_in_usec, addr, bandwidth, mtu, (int) con->windowLimit);
 	#endif
 }
 
@@ -656,5 +1960,44 @@ void transport_receive(CnetAddr addr, char *data, size_t size)
  */
 void transport_init()
 {
-	connections = hashtable_new(0);
+	connections = addrmap_new(sizeof(CONNECTION));
+
+	congestion_select(CONGESTION_CONTROL);
+	congestion_load(CONGESTION_FILE);
+	#if LOGGING == true
+	printf("%lld: [congestion_control] %s\n", nodeinfo.time_in_usec, congestion_name());
+	#endif
+
+	pacer.addrs    = NULL;
+	pacer.capacity = 0;
+	pacer.first    = 0;
+	pacer.count    = 0;
+	pacer.timer    = -1;
+
+	memset(&ackCounters, 0, sizeof(ackCounters));
+	lastCompaction = nodeinfo.time_in_usec;
+}
+
+
+/**
+ * Prints the ACK counters of the node, if ACK_STATS is true.
+ * The saved bytes are the explicit ACKs, which were not sent compared
+ * with one explicit ACK per received segment.
+ * Prints the memory of the transport layer, if MEMORY_STATS is true.
+ */
+void transport_shutdown()
+{
+	#if MEMORY_STATS == true
+	printf("%lld: [transport_memory] connections: %d bytes: %d\n",
+				 nodeinfo.time_in_usec, addrmap_nitems(connections), (int) transport_memory());
+	#endif
+
+	#if ACK_STATS == true
+	size_t saved = ackCounters.segments > ackCounters.acks ? ackCounters.segments - ackCounters.acks : 0;
+
+	printf("%lld: [ack_stats] segments: %d acks: %d piggybacked: %d ack_bytes: %d saved_bytes: %d\n",
+				 nodeinfo.time_in_usec, (int) ackCounters.segments, (int) ackCounters.acks,
+				 (int) ackCounters.piggybacked, (int) ackCounters.ackBytes,
+				 (int) (saved * sizeof(marshaled_segment_header)));
+	#endif
 }
@@ -10,7 +10,10 @@
 #define TRANSPORT_H_
 
 void transport_transmit(CnetAddr addr, char *data, size_t size);
-void transport_receive(CnetAddr addr, char *data, size_t size);
+void transport_receive(CnetAddr addr, char *data, size_t size, bool congested);
+void transport_receive_multicast(CnetAddr addr, CnetAddr group, char *data, size_t size);
+void transport_route_changed(CnetAddr addr);
 void transport_init();
+void transport_shutdown();
 
 #endif
@@ -0,0 +1,92 @@
+/**
+ * weights.h
+ *
+ * @autors Stefan Tombers, Alexander Bunte, Jonas Bürse
+ *
+ * Routing weights as network.c sends them, shared with the route compiler
+ * so that precomputed routes match the ones the nodes converge to.
+ */
+
+#ifndef WEIGHTS_H_
+#define WEIGHTS_H_
+
+#include <math.h>
+
+/**
+ * Weight of a route to an unreachable destination.
+ * Larger weights are cut down to it, which bounds counting to infinity.
+ */
+#define ROUTING_INFINITY (1 << 24)
+
+/**
+ * If true, distance information is sent in a compact encoding with
+ * delta coded addresses and one byte codes for weight, delay, bandwidth
+ * and MTU, instead of as DISTANCE_INFO structs.
+ */
+#define USE_COMPACT_ROUTING true
+
+/**
+ * Code of an infinite weight or unlimited bandwidth in the compact encoding.
+ */
+#define COMPACT_MAX_CODE 255
+
+/**
+ * Weights and delays below this are encoded exactly, larger ones on a
+ * log scale with WEIGHT_CODES_PER_OCTAVE codes per doubling.
+ */
+#define EXACT_WEIGHTS 64
+#define WEIGHT_CODES_PER_OCTAVE 10
+
+
+/**
+ * Returns the weight or delay a compact code stands for.
+ * The values are ascending, the last code is ROUTING_INFINITY.
+ *
+ * @param code Code between 0 and COMPACT_MAX_CODE.
+ */
+static inline int weight_code_value(int code)
+{
+	if(code >= COMPACT_MAX_CODE) {
+		return ROUTING_INFINITY;
+	}
+
+	double weight = code < EXACT_WEIGHTS ? code
+			: ceil(EXACT_WEIGHTS * pow(2., (code - EXACT_WEIGHTS + 1.) / WEIGHT_CODES_PER_OCTAVE));
+	return weight < ROUTING_INFINITY ? weight : ROUTING_INFINITY;
+}
+
+
+/**
+ * Returns a weight or delay as the neighbours receive it: rounded up to
+ * the next code value in the compact encoding, unchanged otherwise.
+ *
+ * @param weight Weight of at least 0.
+ * @return Weight as received, at most ROUTING_INFINITY.
+ */
+static inline int quantize_weight(int weight)
+{
+	if(weight >= ROUTING_INFINITY) {
+		return ROUTING_INFINITY;
+	}
+#if USE_COMPACT_ROUTING == true
+	if(weight < EXACT_WEIGHTS) {
+		return weight;
+	}
+
+	/* estimate the code from the log scale, then correct rounding errors */
+	int code = EXACT_WEIGHTS - 1 + (int) ceil(WEIGHT_CODES_PER_OCTAVE * log2((double) weight / EXACT_WEIGHTS));
+	code = code < EXACT_WEIGHTS ? EXACT_WEIGHTS : code;
+	code = code > COMPACT_MAX_CODE ? COMPACT_MAX_CODE : code;
+	while(code > EXACT_WEIGHTS && weight_code_value(code - 1) >= weight) {
+		code--;
+	}
+	while(code < COMPACT_MAX_CODE && weight_code_value(code) < weight) {
+		code++;
+	}
+	return weight_code_value(code);
+#else
+	return weight;
+#endif
+}
+
+#endif